@@ -0,0 +1,19 @@
+# Merge the clang .profraw files written by a GBEMU_PGO=GENERATE build into
+# the default.profdata read by GBEMU_PGO=USE.
+#
+# Usage: cmake -DLLVM_PROFDATA=<path> -DPGO_DIR=<dir> -P MergeProfiles.cmake
+
+file(GLOB raw_profiles "${PGO_DIR}/*.profraw")
+
+if(NOT raw_profiles)
+  message(FATAL_ERROR "No .profraw files in ${PGO_DIR}, run the training first")
+endif()
+
+execute_process(
+  COMMAND ${LLVM_PROFDATA} merge -output=${PGO_DIR}/default.profdata
+    ${raw_profiles}
+  RESULT_VARIABLE result)
+
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "llvm-profdata merge failed")
+endif()
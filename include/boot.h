@@ -0,0 +1,10 @@
+#pragma once
+
+#include "cart.h"
+#include "cpu.h"
+#include "mem.h"
+
+void boot_skip(cpu_ctx_t *ctx_p, mem_t *mem_p,
+               const cart_metadata_t *metadata_p);
+bool boot_rom_load(mem_t *mem_p, const char *boot_rom_path_p);
+void boot_from_rom(cpu_ctx_t *ctx_p, mem_t *mem_p);
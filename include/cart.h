@@ -21,17 +21,28 @@ typedef struct cart_metadata {
   u16 global_checksum;
 } cart_metadata_t;
 
+/* Largest cartridge RAM: 16 banks of 8KiB, RAM size code 0x04 */
+#define CART_RAM_MAX_BYTES (128 * 1024)
+
 typedef struct cart {
   char filename[1024];
   u32 rom_size_bytes;
-  cart_metadata_t *metadata;
+  /* Copy of the header, the ROM image itself is left untouched */
+  cart_metadata_t metadata;
   u8 *rom_p;
+  /* External RAM, NULL when not allocated */
+  u8 *ram_p;
+  u32 ram_size_bytes;
 } cart_t;
 
 void format_cart_metadata(char *buf_p, size_t buflen, cart_metadata_t metadata);
 void print_cart_metadata();
 cart_t load_cart(char *p_cart_path);
+bool cart_parse(cart_t *cart_p, const char *cart_path_p, u8 *rom_p,
+                u32 rom_size_bytes);
+void unload_cart(cart_t *cart_p);
 const char *lookup_new_licensee_name(char *p_code);
 const char *get_licensee_name(u8 old_lic_code, u16 new_lic_code);
 void get_human_rom_size(char *buf_p, size_t buflen, u8 rom_size_code);
 int get_ram_size_kib(u8 ram_size_code);
+u32 cart_ram_size_bytes(const cart_metadata_t *metadata_p);
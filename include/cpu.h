@@ -14,8 +14,25 @@ static const bool INVALID_FLAG_CODE = false;
 
 typedef enum { FLAG_ZERO, FLAG_SUBTRACT, FLAG_HALF_CARRY, FLAG_CARRY } flag_t;
 
+/* Interrupt flags, as found in IE and IF */
+#define INT_VBLANK 0x01
+#define INT_LCD 0x02
+#define INT_TIMER 0x04
+#define INT_SERIAL 0x08
+#define INT_JOYPAD 0x10
+#define INT_MASK 0x1F
+
 typedef struct ctx {
   registers_t regs;
+  /* T-cycles since power up */
+  u64 cycles;
+  /* Interrupt master enable */
+  bool ime;
+  bool halted;
+  bool stopped;
+  /* Set when HALT is executed with IME off and an interrupt pending: the CPU
+   * does not halt and the byte after HALT is read twice. */
+  bool halt_bug;
 } cpu_ctx_t;
 
 /**
@@ -117,3 +134,5 @@ static inline bool set_flag(registers_t *regs_p, flag_t flag, bool value) {
 };
 
 void cpu_init(cpu_ctx_t *ctx_p);
+void cpu_halt(cpu_ctx_t *ctx_p, u8 ie, u8 if_reg);
+void cpu_stop(cpu_ctx_t *ctx_p);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cart.h"
+#include "mem.h"
+#include "scheduler.h"
+#include "sprite.h"
+
+/* 1 M-cycle of setup, then one byte per M-cycle */
+#define DMA_SETUP_CYCLES 4
+#define DMA_CYCLES (DMA_SETUP_CYCLES + OAM_SIZE * 4)
+
+/* Buses the CPU and the DMA can contend for. I/O registers and HRAM sit on
+ * the CPU's internal bus, which the DMA never uses. */
+typedef enum {
+  DMA_BUS_INTERNAL,
+  /* ROM, cartridge RAM and WRAM */
+  DMA_BUS_EXTERNAL,
+  DMA_BUS_VIDEO,
+  DMA_BUS_OAM,
+} dma_bus_t;
+
+typedef struct dma {
+  bool active;
+  /* Bus the source is read from */
+  dma_bus_t bus;
+  /* Cycle FF46 was written at */
+  u64 start;
+  /* The 160 source bytes, NULL for unmapped sources that read as 0xFF */
+  const u8 *source_p;
+  mem_t *mem_p;
+  sprite_cache_t *sprites_p;
+} dma_t;
+
+void dma_init(dma_t *dma_p, sched_t *sched_p, mem_t *mem_p,
+              sprite_cache_t *sprites_p);
+const u8 *dma_source(const mem_t *mem_p, const cart_t *cart_p, u8 page);
+void dma_start(dma_t *dma_p, sched_t *sched_p, const cart_t *cart_p, u8 page,
+               u64 now);
+dma_bus_t dma_bus(u16 addr);
+bool dma_bus_conflict(const dma_t *dma_p, u16 addr, u64 now);
+u8 dma_conflict_value(const dma_t *dma_p, u16 addr, u64 now);
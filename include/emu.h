@@ -1,3 +1,31 @@
 #pragma once
 
+#include "cart.h"
+#include "cpu.h"
+#include "dma.h"
+#include "link.h"
+#include "mem.h"
+#include "scheduler.h"
+#include "sprite.h"
+
+/* Arena regions are aligned to pages so guest memory can be snapshotted with
+ * copy-on-write mappings */
+#define EMU_ARENA_ALIGN 4096
+
+/* One emulator instance. It lives at the start of its arena, followed by
+ * guest memory, cartridge RAM and the ROM, all released at once by
+ * emu_destroy(). */
+typedef struct emu {
+  cpu_ctx_t cpu;
+  sched_t sched;
+  dma_t dma;
+  link_t link;
+  sprite_cache_t sprites;
+  cart_t cart;
+  mem_t *mem_p;
+  size_t arena_bytes;
+} emu_t;
+
+emu_t *emu_create(const char *rom_path_p);
+void emu_destroy(emu_t *emu_p);
 int emu_run(int argc, char *argv[]);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "cpu.h"
+#include "mem.h"
+#include "scheduler.h"
+
+typedef enum {
+  IDLE_EXIT_EQUAL,
+  IDLE_EXIT_NOT_EQUAL,
+  IDLE_EXIT_GREATER_OR_EQUAL,
+  IDLE_EXIT_LESS,
+} idle_exit_t;
+
+/* A loop that only polls an I/O register, such as
+ *
+ *   .wait: ldh a, [rLY]
+ *          cp 144
+ *          jr nz, .wait
+ *
+ * It exits once `(register & mask) <exit> operand` holds. */
+typedef struct idle_loop {
+  /* Offset of the polled register in mem_t.io */
+  u8 reg;
+  u8 mask;
+  u8 operand;
+  idle_exit_t exit;
+  /* T-cycles taken by one iteration that does not exit */
+  u8 iteration_cycles;
+} idle_loop_t;
+
+bool idle_skip_halt(cpu_ctx_t *ctx_p, mem_t *mem_p, sched_t *sched_p,
+                    u64 limit);
+bool idle_detect_poll(const u8 *code_p, size_t len, idle_loop_t *loop_p);
+bool idle_poll_exits(const idle_loop_t *loop_p, u8 value);
+u64 idle_skip_poll(cpu_ctx_t *ctx_p, mem_t *mem_p, sched_t *sched_p,
+                   const idle_loop_t *loop_p, u64 limit);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include "common.h"
+#include "mem.h"
+#include "scheduler.h"
+
+/* 8 bits at 8192Hz with the internal clock */
+#define LINK_TRANSFER_CYCLES 4096
+
+/* How often a connected instance checks for transfers clocked by its peer:
+ * one bit at 8192Hz */
+#define LINK_POLL_CYCLES 512
+
+/* SC bits */
+#define SC_TRANSFER 0x80
+#define SC_INTERNAL_CLOCK 0x01
+
+/* One end of the cable. Every field is only written by the instance plugged
+ * into it, which is what makes the exchange lock-free. */
+typedef struct link_port {
+  _Atomic bool attached;
+  /* Process plugged in, so that ports left behind by a crashed process can
+   * be detected and reclaimed */
+  _Atomic int owner_pid;
+  /* Transfers started with the internal clock, and the last one's byte and
+   * completion time (relative to the instance's connection) */
+  _Atomic u32 seq;
+  _Atomic u8 data;
+  _Atomic u64 done_at;
+  /* Last peer transfer answered, and the byte answered with */
+  _Atomic u32 ack;
+  _Atomic u8 reply;
+} link_port_t;
+
+/* Lives in plain memory for instances in one process, or in a POSIX shared
+ * memory object for instances in separate processes. */
+typedef struct link_cable {
+  link_port_t ports[2];
+} link_cable_t;
+
+typedef struct link {
+  link_cable_t *cable_p;
+  int port;
+  /* Cycle count when connected, so that both ends compare elapsed cycles */
+  u64 base;
+  /* Local copies of our port's seq and ack, so that polling with nothing
+   * pending only loads the peer's seq */
+  u32 seq;
+  u32 answered;
+  /* A transfer clocked by this instance reached its end before the peer
+   * answered it, see link_waiting() */
+  bool waiting;
+  mem_t *mem_p;
+  sched_t *sched_p;
+} link_t;
+
+link_cable_t *link_cable_create(void);
+void link_cable_destroy(link_cable_t *cable_p);
+link_cable_t *link_cable_open_shared(const char *name_p);
+void link_cable_close_shared(link_cable_t *cable_p);
+void link_cable_unlink_shared(const char *name_p);
+
+void link_init(link_t *link_p, sched_t *sched_p, mem_t *mem_p);
+bool link_connect(link_t *link_p, link_cable_t *cable_p, u64 now);
+void link_disconnect(link_t *link_p);
+void link_serial_control(link_t *link_p, u8 value, u64 now);
+void link_poll(link_t *link_p, u64 now);
+bool link_waiting(const link_t *link_p);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "common.h"
+
+/* https://gbdev.io/pandocs/Memory_Map.html */
+#define VRAM_START 0x8000
+#define VRAM_SIZE 0x2000
+#define CART_RAM_START 0xA000
+#define WRAM_START 0xC000
+#define WRAM_SIZE 0x2000
+#define OAM_START 0xFE00
+#define OAM_SIZE 0xA0
+#define IO_START 0xFF00
+#define IO_SIZE 0x80
+#define HRAM_START 0xFF80
+#define HRAM_SIZE 0x7F
+#define IE_ADDR 0xFFFF
+
+#define BOOT_ROM_SIZE 0x100
+
+/* I/O registers, as offsets into mem_t.io */
+#define IO_REG(addr) ((addr) - IO_START)
+#define REG_P1 IO_REG(0xFF00)
+#define REG_SB IO_REG(0xFF01)
+#define REG_SC IO_REG(0xFF02)
+#define REG_DIV IO_REG(0xFF04)
+#define REG_TIMA IO_REG(0xFF05)
+#define REG_TMA IO_REG(0xFF06)
+#define REG_TAC IO_REG(0xFF07)
+#define REG_IF IO_REG(0xFF0F)
+#define REG_LCDC IO_REG(0xFF40)
+#define REG_STAT IO_REG(0xFF41)
+#define REG_SCY IO_REG(0xFF42)
+#define REG_SCX IO_REG(0xFF43)
+#define REG_LY IO_REG(0xFF44)
+#define REG_LYC IO_REG(0xFF45)
+#define REG_DMA IO_REG(0xFF46)
+#define REG_BGP IO_REG(0xFF47)
+#define REG_OBP0 IO_REG(0xFF48)
+#define REG_OBP1 IO_REG(0xFF49)
+#define REG_WY IO_REG(0xFF4A)
+#define REG_WX IO_REG(0xFF4B)
+#define REG_BOOT IO_REG(0xFF50)
+
+/* Guest memory other than the cartridge. The small regions touched on nearly
+ * every instruction or scanline come first so they share a few cache lines;
+ * the 8KiB banks follow. */
+typedef struct mem {
+  u8 io[IO_SIZE];
+  u8 hram[HRAM_SIZE];
+  u8 ie;
+  u8 oam[OAM_SIZE];
+  u8 wram[WRAM_SIZE];
+  u8 vram[VRAM_SIZE];
+  /* Mapped over 0x0000-0x00FF until the boot ROM writes to REG_BOOT */
+  u8 boot_rom[BOOT_ROM_SIZE];
+} mem_t;
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "common.h"
+
+typedef enum {
+  ROM_FORMAT_RAW,
+  ROM_FORMAT_GZIP,
+  ROM_FORMAT_ZIP,
+  ROM_FORMAT_7Z,
+} rom_format_t;
+
+/* Largest ROM size code (0x08) in the header */
+#define ROM_MAX_SIZE_BYTES (8 * 1024 * 1024)
+
+/* When set, decompressed ROMs are kept in this directory and reused by later
+ * runs instead of decompressing the archive again. */
+#define ROM_CACHE_ENV "GBEMU_ROM_CACHE"
+
+rom_format_t rom_file_format(const char *rom_path_p);
+bool rom_file_size(const char *rom_path_p, u32 *size_p);
+bool rom_file_read(const char *rom_path_p, u8 *buf_p, u32 size);
+u64 rom_hash(const u8 *data_p, size_t len);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common.h"
+
+/* Timestamp of events that are not scheduled */
+#define SCHED_NEVER UINT64_MAX
+
+typedef enum {
+  SCHED_EVENT_LY,
+  SCHED_EVENT_VBLANK,
+  SCHED_EVENT_STAT,
+  SCHED_EVENT_TIMER,
+  SCHED_EVENT_SERIAL,
+  SCHED_EVENT_DMA,
+  /* Serving the link cable's peer, see link.h */
+  SCHED_EVENT_LINK,
+  SCHED_EVENT_COUNT
+} sched_event_type_t;
+
+/**
+ * Called when an event fires. `when` is the cycle the event was due at, which
+ * can be earlier than the current cycle count after a fast-forward.
+ */
+typedef void (*sched_handler_t)(void *user_p, u64 when);
+
+typedef struct sched_event {
+  u64 when;
+  /* Cycles until the event repeats, 0 for one-shot events */
+  u64 period;
+  /* Interrupt flags (IF bits) raised when the event fires */
+  u8 irq;
+  sched_handler_t handler_fn;
+  void *user_p;
+} sched_event_t;
+
+/* One slot per event type: there are few enough of them that a linear scan
+ * beats keeping a heap ordered. */
+typedef struct sched {
+  sched_event_t events[SCHED_EVENT_COUNT];
+  /* Set by a handler while time must not advance, such as a link transfer
+   * waiting on its peer: idle skips return as soon as they see it */
+  bool stop;
+} sched_t;
+
+void sched_init(sched_t *sched_p);
+void sched_add(sched_t *sched_p, sched_event_type_t type, u64 when, u64 period,
+               u8 irq);
+void sched_set_handler(sched_t *sched_p, sched_event_type_t type,
+                       sched_handler_t handler_fn, void *user_p);
+void sched_cancel(sched_t *sched_p, sched_event_type_t type);
+u64 sched_next(const sched_t *sched_p, sched_event_type_t *type_p);
+u8 sched_fire_due(sched_t *sched_p, u64 now, u8 *if_p);
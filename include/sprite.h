@@ -0,0 +1,34 @@
+#pragma once
+
+#include "common.h"
+#include "mem.h"
+
+#define SCREEN_HEIGHT 144
+#define OAM_ENTRIES 40
+#define SPRITES_PER_LINE 10
+
+/* https://gbdev.io/pandocs/OAM.html */
+typedef struct oam_entry {
+  u8 y;
+  u8 x;
+  u8 tile;
+  u8 flags;
+} oam_entry_t;
+
+/* Sprites drawn on each line, as OAM indexes ordered by drawing priority.
+ * Rebuilt lazily after OAM or the sprite size changes rather than scanning
+ * the 40 entries on every line. */
+typedef struct sprite_cache {
+  bool dirty;
+  /* Sprite height the lists were built for, 8 or 16 */
+  u8 height;
+  u8 counts[SCREEN_HEIGHT];
+  u8 lines[SCREEN_HEIGHT][SPRITES_PER_LINE];
+} sprite_cache_t;
+
+void sprite_cache_init(sprite_cache_t *cache_p);
+void sprite_cache_invalidate(sprite_cache_t *cache_p);
+void sprite_oam_write(sprite_cache_t *cache_p, mem_t *mem_p, u16 addr,
+                      u8 value);
+const u8 *sprite_cache_line(sprite_cache_t *cache_p, const mem_t *mem_p,
+                            u8 ly, u8 *count_p);
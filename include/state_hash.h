@@ -0,0 +1,81 @@
+#pragma once
+
+#include "common.h"
+#include "cpu.h"
+
+/* Log files start with this magic followed by a 16-bit little endian format
+ * version and the number of hashed components per record. Bump the version
+ * whenever what a component hashes changes, so old logs are rejected instead
+ * of diverging at frame 0. Version 2 added the cycle count and the
+ * interrupt/halt state to the CPU hash. */
+#define STATE_HASH_MAGIC "GBSH"
+#define STATE_HASH_VERSION 2
+
+/* Starting value for state_hash_bytes() (FNV-1a 32-bit offset basis) */
+#define STATE_HASH_INIT 0x811C9DC5U
+
+typedef enum {
+  STATE_HASH_CPU,
+  STATE_HASH_RAM,
+  STATE_HASH_FRAMEBUFFER,
+  STATE_HASH_COMPONENT_COUNT
+} state_hash_component_t;
+
+/* Size of one record on disk: the frame number then one hash per component,
+ * all stored as 32-bit little endian values. */
+#define STATE_HASH_RECORD_BYTES (4 * (1 + STATE_HASH_COMPONENT_COUNT))
+
+/* Views into the emulator state hashed at a frame boundary. Any region left
+ * NULL hashes to the empty-input value so logs stay comparable while
+ * subsystems are missing. */
+typedef struct state_snapshot {
+  const cpu_ctx_t *cpu_p;
+  const u8 *ram_p;
+  size_t ram_len;
+  const u8 *framebuffer_p;
+  size_t framebuffer_len;
+} state_snapshot_t;
+
+typedef struct state_hash_record {
+  u32 frame;
+  u32 hashes[STATE_HASH_COMPONENT_COUNT];
+} state_hash_record_t;
+
+typedef struct state_hash_log {
+  FILE *file_p;
+  u32 frame;
+} state_hash_log_t;
+
+/* Result of comparing two logs. `component` is STATE_HASH_COMPONENT_COUNT
+ * when the logs only differ in length. */
+typedef struct state_hash_divergence {
+  u32 frame;
+  state_hash_component_t component;
+  u32 expected;
+  u32 actual;
+} state_hash_divergence_t;
+
+typedef enum {
+  STATE_HASH_DIFF_IDENTICAL,
+  STATE_HASH_DIFF_DIVERGED,
+  STATE_HASH_DIFF_LENGTH,
+  STATE_HASH_DIFF_BAD_LOG,
+} state_hash_diff_result_t;
+
+u32 state_hash_bytes(u32 hash, const u8 *data_p, size_t len);
+u32 state_hash_cpu(const cpu_ctx_t *cpu_p);
+void state_hash_frame(state_hash_record_t *record_p, u32 frame,
+                      const state_snapshot_t *snapshot_p);
+const char *state_hash_component_name(state_hash_component_t component);
+
+bool state_hash_log_open(state_hash_log_t *log_p, const char *path_p);
+bool state_hash_log_frame(state_hash_log_t *log_p,
+                          const state_snapshot_t *snapshot_p);
+void state_hash_log_close(state_hash_log_t *log_p);
+
+bool state_hash_write_header(FILE *file_p);
+bool state_hash_read_header(FILE *file_p);
+bool state_hash_write_record(FILE *file_p, const state_hash_record_t *record_p);
+bool state_hash_read_record(FILE *file_p, state_hash_record_t *record_p);
+state_hash_diff_result_t state_hash_diff(FILE *expected_p, FILE *actual_p,
+                                         state_hash_divergence_t *divergence_p);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "cpu.h"
+
+/* Trace files start with this magic followed by a 16-bit little endian format
+ * version, then hold TRACE_RECORD_BYTES records back to back. */
+#define TRACE_MAGIC "GBTR"
+#define TRACE_VERSION 1
+#define TRACE_RECORD_BYTES 24
+
+/* Default and largest ring sizes, as power of two numbers of records */
+#define TRACE_DEFAULT_CAPACITY_LOG2 16
+#define TRACE_MAX_CAPACITY_LOG2 24
+
+/* State before executing the instruction at pc */
+typedef struct trace_record {
+  u64 cycles;
+  u16 pc, sp;
+  u8 a, f, b, c, d, e, h, l;
+  /* Opcode at pc and the 3 bytes after it */
+  u8 pcmem[4];
+} trace_record_t;
+
+/* Single producer (the emulation thread), single consumer (the writer
+ * thread). Each side only ever stores its own index, so no locks are needed. */
+typedef struct trace {
+  trace_record_t *ring_p;
+  u64 mask;
+  _Atomic u64 head;
+  _Atomic u64 tail;
+  _Atomic bool stop;
+  /* Times the emulation thread had to wait for the writer to catch up */
+  u64 stalls;
+  FILE *file_p;
+  pthread_t writer;
+  bool writer_started;
+  /* Set by the writer on the first failed write, the rest is discarded */
+  _Atomic bool write_failed;
+} trace_t;
+
+bool trace_open(trace_t *trace_p, const char *path_p, u8 capacity_log2);
+void trace_close(trace_t *trace_p);
+void trace_wait_for_space(trace_t *trace_p);
+
+bool trace_read_header(FILE *file_p);
+bool trace_read_record(FILE *file_p, trace_record_t *record_p);
+void trace_encode_record(u8 *buf_p, const trace_record_t *record_p);
+void trace_format_doctor(char *buf_p, size_t buflen,
+                         const trace_record_t *record_p);
+
+/**
+ * @brief Append the CPU state to the trace, called before each instruction
+ * @param trace_p Open trace
+ * @param ctx_p CPU context
+ * @param pcmem_p The 4 bytes at PC
+ *
+ * Kept inline so that tracing costs a copy and an atomic store per
+ * instruction; the file I/O happens on the writer thread.
+ */
+static inline void trace_record(trace_t *trace_p, const cpu_ctx_t *ctx_p,
+                                const u8 *pcmem_p) {
+  u64 head = atomic_load_explicit(&trace_p->head, memory_order_relaxed);
+
+  if (head - atomic_load_explicit(&trace_p->tail, memory_order_acquire) >
+      trace_p->mask) {
+    trace_wait_for_space(trace_p);
+  }
+
+  const registers_t *regs_p = &ctx_p->regs;
+  trace_record_t *record_p = &trace_p->ring_p[head & trace_p->mask];
+
+  *record_p = (trace_record_t){
+      .cycles = ctx_p->cycles,
+      .pc = regs_p->pc,
+      .sp = regs_p->sp,
+      .a = regs_p->a,
+      .f = regs_p->f,
+      .b = regs_p->b,
+      .c = regs_p->c,
+      .d = regs_p->d,
+      .e = regs_p->e,
+      .h = regs_p->h,
+      .l = regs_p->l,
+  };
+  memcpy(record_p->pcmem, pcmem_p, sizeof(record_p->pcmem));
+
+  atomic_store_explicit(&trace_p->head, head + 1, memory_order_release);
+}
@@ -0,0 +1,203 @@
+/**
+ * @file boot.c
+ * @brief Power up sequence: either run a boot ROM or jump straight to the
+ * state it leaves behind
+ * @author Coaxial
+ * @date 2026-10-19
+ */
+
+#include "boot.h"
+
+typedef struct io_init {
+  u16 addr;
+  u8 value;
+} io_init_t;
+
+/* DMG I/O registers after the boot ROM, as per
+ * https://gbdev.io/pandocs/Power_Up_Sequence.html#hardware-registers
+ * Registers not listed here read back as 0xFF. */
+static const io_init_t DMG_POST_BOOT_IO[] = {
+    {0xFF00, 0xCF}, /* P1 */
+    {0xFF01, 0x00}, /* SB */
+    {0xFF02, 0x7E}, /* SC */
+    {0xFF04, 0xAB}, /* DIV */
+    {0xFF05, 0x00}, /* TIMA */
+    {0xFF06, 0x00}, /* TMA */
+    {0xFF07, 0xF8}, /* TAC */
+    {0xFF0F, 0xE1}, /* IF */
+    {0xFF10, 0x80}, /* NR10 */
+    {0xFF11, 0xBF}, /* NR11 */
+    {0xFF12, 0xF3}, /* NR12 */
+    {0xFF13, 0xFF}, /* NR13 */
+    {0xFF14, 0xBF}, /* NR14 */
+    {0xFF16, 0x3F}, /* NR21 */
+    {0xFF17, 0x00}, /* NR22 */
+    {0xFF18, 0xFF}, /* NR23 */
+    {0xFF19, 0xBF}, /* NR24 */
+    {0xFF1A, 0x7F}, /* NR30 */
+    {0xFF1B, 0xFF}, /* NR31 */
+    {0xFF1C, 0x9F}, /* NR32 */
+    {0xFF1D, 0xFF}, /* NR33 */
+    {0xFF1E, 0xBF}, /* NR34 */
+    {0xFF20, 0xFF}, /* NR41 */
+    {0xFF21, 0x00}, /* NR42 */
+    {0xFF22, 0x00}, /* NR43 */
+    {0xFF23, 0xBF}, /* NR44 */
+    {0xFF24, 0x77}, /* NR50 */
+    {0xFF25, 0xF3}, /* NR51 */
+    {0xFF26, 0xF1}, /* NR52 */
+    {0xFF40, 0x91}, /* LCDC */
+    {0xFF41, 0x85}, /* STAT */
+    {0xFF42, 0x00}, /* SCY */
+    {0xFF43, 0x00}, /* SCX */
+    {0xFF44, 0x00}, /* LY */
+    {0xFF45, 0x00}, /* LYC */
+    {0xFF46, 0xFF}, /* DMA */
+    {0xFF47, 0xFC}, /* BGP */
+    {0xFF48, 0x00}, /* OBP0, left uninitialized by the boot ROM */
+    {0xFF49, 0x00}, /* OBP1, left uninitialized by the boot ROM */
+    {0xFF4A, 0x00}, /* WY */
+    {0xFF4B, 0x00}, /* WX */
+    {0xFF50, 0x01}, /* BOOT, boot ROM unmapped */
+};
+
+/* The (R) tile the boot ROM draws next to the logo */
+static const u8 REGISTERED_TILE[] = {0x3C, 0x42, 0xB9, 0xA5,
+                                     0xB9, 0xA5, 0x42, 0x3C};
+
+/* The logo goes in tiles 1 to 24, followed by the (R) tile */
+static const u16 LOGO_TILES_ADDR = 0x8010;
+static const u8 REGISTERED_TILE_INDEX = 0x19;
+static const u16 REGISTERED_TILE_MAP_ADDR = 0x9910;
+static const u16 LOGO_TOP_ROW_END_ADDR = 0x990F;
+static const u16 LOGO_BOTTOM_ROW_END_ADDR = 0x992F;
+static const int LOGO_ROW_TILES = 12;
+
+/**
+ * @brief Double every bit of a nibble, making it a full byte wide
+ * @param nibble Value in the low 4 bits
+ * @return The widened byte
+ */
+static u8 widen_nibble(u8 nibble) {
+  u8 wide = 0;
+
+  for (int i = 0; i < 4; i++) {
+    if (BIT(nibble, i)) {
+      wide |= 0x03 << (i * 2);
+    }
+  }
+
+  return wide;
+}
+
+/**
+ * @brief Draw the cartridge logo in VRAM the way the boot ROM does
+ * @param vram_p VRAM
+ * @param logo_p The 48 bytes logo from the cartridge header
+ *
+ * Every nibble of the header logo is one row of 4 pixels. The boot ROM scales
+ * it 2x in both directions, so each nibble ends up as two identical rows of a
+ * tile, on bit plane 0 only.
+ */
+static void draw_logo(u8 *vram_p, const u8 *logo_p) {
+  u8 *tile_p = vram_p + (LOGO_TILES_ADDR - VRAM_START);
+
+  for (int i = 0; i < 48; i++) {
+    u8 rows[] = {widen_nibble(logo_p[i] >> 4), widen_nibble(logo_p[i] & 0x0F)};
+
+    for (int j = 0; j < 2; j++) {
+      *tile_p = rows[j];
+      tile_p += 2;
+      *tile_p = rows[j];
+      tile_p += 2;
+    }
+  }
+
+  for (size_t i = 0; i < sizeof(REGISTERED_TILE); i++) {
+    *tile_p = REGISTERED_TILE[i];
+    tile_p += 2;
+  }
+
+  vram_p[REGISTERED_TILE_MAP_ADDR - VRAM_START] = REGISTERED_TILE_INDEX;
+
+  /* Tile indexes are written backwards from the end of each row */
+  u8 tile = REGISTERED_TILE_INDEX - 1;
+  u16 row_ends[] = {LOGO_BOTTOM_ROW_END_ADDR, LOGO_TOP_ROW_END_ADDR};
+  for (int row = 0; row < 2; row++) {
+    for (int i = 0; i < LOGO_ROW_TILES; i++) {
+      vram_p[row_ends[row] - VRAM_START - i] = tile--;
+    }
+  }
+}
+
+/**
+ * @brief Put the CPU and memory in the state the DMG boot ROM leaves them in
+ * @param ctx_p CPU context
+ * @param mem_p Guest memory
+ * @param metadata_p Header of the inserted cartridge
+ *
+ * This is what running the boot ROM ends with, minus the ~2.5M cycles it
+ * takes to scroll the logo.
+ */
+void boot_skip(cpu_ctx_t *ctx_p, mem_t *mem_p,
+               const cart_metadata_t *metadata_p) {
+  cpu_init(ctx_p);
+
+  /* Half carry and carry are left set by the header checksum verification,
+   * unless the checksum is 0. */
+  if (metadata_p->checksum == 0) {
+    set_flag(&ctx_p->regs, FLAG_HALF_CARRY, false);
+    set_flag(&ctx_p->regs, FLAG_CARRY, false);
+  }
+
+  memset(mem_p->io, 0xFF, sizeof(mem_p->io));
+  for (size_t i = 0; i < sizeof(DMG_POST_BOOT_IO) / sizeof(io_init_t); i++) {
+    mem_p->io[IO_REG(DMG_POST_BOOT_IO[i].addr)] = DMG_POST_BOOT_IO[i].value;
+  }
+  mem_p->ie = 0x00;
+
+  memset(mem_p->vram, 0, sizeof(mem_p->vram));
+  draw_logo(mem_p->vram, metadata_p->logo);
+}
+
+/**
+ * @brief Load a DMG boot ROM image
+ * @param mem_p Guest memory to map it in
+ * @param boot_rom_path_p Path to the 256 bytes boot ROM
+ * @return true if successful, false otherwise
+ */
+bool boot_rom_load(mem_t *mem_p, const char *boot_rom_path_p) {
+  FILE *boot_rom_file = fopen(boot_rom_path_p, "rb");
+
+  if (boot_rom_file == NULL) {
+    printf("Error opening file: %s\n", boot_rom_path_p);
+    return false;
+  }
+
+  size_t read =
+      fread(mem_p->boot_rom, 1, sizeof(mem_p->boot_rom), boot_rom_file);
+  fclose(boot_rom_file);
+
+  if (read != sizeof(mem_p->boot_rom)) {
+    printf("Boot ROM must be %d bytes: %s\n", BOOT_ROM_SIZE, boot_rom_path_p);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Power up with the boot ROM mapped, for it to be run from 0x0000
+ * @param ctx_p CPU context
+ * @param mem_p Guest memory, with the boot ROM loaded
+ */
+void boot_from_rom(cpu_ctx_t *ctx_p, mem_t *mem_p) {
+  *ctx_p = (cpu_ctx_t){};
+
+  memset(mem_p->io, 0xFF, sizeof(mem_p->io));
+  mem_p->io[REG_LCDC] = 0x00;
+  mem_p->io[REG_LY] = 0x00;
+  mem_p->io[REG_BOOT] = 0x00;
+  mem_p->ie = 0x00;
+  memset(mem_p->vram, 0, sizeof(mem_p->vram));
+}
@@ -6,6 +6,7 @@
  */
 
 #include "cart.h"
+#include "rom_file.h"
 
 /* ROM type codes to names, as per
  * https://gbdev.io/pandocs/The_Cartridge_Header.html#0147-rom-type */
@@ -274,55 +275,93 @@ const int RAM_SIZES_KIB[] = {0, -1, 8, 32, 128, 64};
 const u8 SEE_NEW_LICENSEE_CODE_FLAG = 0x33;
 static cart_t ctx;
 
+/* The header ends at 0x14F */
+static const u32 MIN_ROM_SIZE_BYTES = 0x150;
+
 /**
- * @brief Load a cartridge from a path
- * @param cart_path_p Path to the cartridge file
- * @return returns a cart_t struct containing a representation of the cartridge
+ * @brief Set up a cartridge from a ROM image already in memory
+ * @param cart_p Cartridge to initialize
+ * @param cart_path_p Path the ROM was read from
+ * @param rom_p ROM image, owned by the caller
+ * @param rom_size_bytes Size of the ROM image
+ * @return true if successful, false if the image is too small for a header
  */
-cart_t load_cart(char *cart_path_p) {
-  strncpy(ctx.filename, cart_path_p, sizeof(ctx.filename) - 1);
-
-  FILE *rom_file = fopen(ctx.filename, "rb");
-
-  if (rom_file == NULL) {
-    printf("Error opening file: %s\n", ctx.filename);
-    exit(1);
+bool cart_parse(cart_t *cart_p, const char *cart_path_p, u8 *rom_p,
+                u32 rom_size_bytes) {
+  if (rom_size_bytes < MIN_ROM_SIZE_BYTES) {
+    return false;
   }
 
-  fseek(rom_file, 0, SEEK_END);
-
-  ctx.rom_size_bytes = ftell(rom_file);
-
-  rewind(rom_file);
-
-  ctx.rom_p = malloc(ctx.rom_size_bytes);
-  fread(ctx.rom_p, ctx.rom_size_bytes, 1, rom_file);
-  fclose(rom_file);
+  strncpy(cart_p->filename, cart_path_p, sizeof(cart_p->filename) - 1);
+  cart_p->filename[sizeof(cart_p->filename) - 1] = '\0';
+  cart_p->rom_p = rom_p;
+  cart_p->rom_size_bytes = rom_size_bytes;
+  /* Metadata starts at 0x100. It is copied out so that the fixups below do
+   * not alter the ROM the guest reads. */
+  memcpy(&cart_p->metadata, rom_p + 0x100, sizeof(cart_metadata_t));
 
-  ctx.metadata =
-      (cart_metadata_t *)(ctx.rom_p + 0x100); // Metadata starts at 0x100
-
-  if (ctx.metadata->old_licensee_code == SEE_NEW_LICENSEE_CODE_FLAG) {
+  if (cart_p->metadata.old_licensee_code == SEE_NEW_LICENSEE_CODE_FLAG) {
     /* Pad the title string when using the new license code as that shrinks the
      * title string to 11 chars instead. */
-    ctx.metadata->title[11] = '\0';
-    ctx.metadata->title[12] = '\0';
-    ctx.metadata->title[13] = '\0';
-    ctx.metadata->title[14] = '\0';
+    cart_p->metadata.title[11] = '\0';
+    cart_p->metadata.title[12] = '\0';
+    cart_p->metadata.title[13] = '\0';
+    cart_p->metadata.title[14] = '\0';
   };
 
   /* Terminate the title string in case it isn't for some reason */
-  ctx.metadata->title[15] = '\0';
+  cart_p->metadata.title[15] = '\0';
 
   /* These 16 bits values are big endian in the ROM. Intel CPUs are little
    * endian, which reverses the bytes when loading them into a struct directly.
    * So we put them back in the original order. */
-  ctx.metadata->new_licensee_code = (ctx.rom_p[0x144] << 8 | ctx.rom_p[0x145]);
-  ctx.metadata->global_checksum = (ctx.rom_p[0x14e] << 8 | ctx.rom_p[0x14f]);
+  cart_p->metadata.new_licensee_code = (rom_p[0x144] << 8 | rom_p[0x145]);
+  cart_p->metadata.global_checksum = (rom_p[0x14e] << 8 | rom_p[0x14f]);
+
+  return true;
+}
+
+/**
+ * @brief Load a cartridge from a path
+ * @param cart_path_p Path to the cartridge file
+ * @return returns a cart_t struct containing a representation of the cartridge
+ *
+ * The ROM buffer is allocated and must be released with unload_cart().
+ */
+cart_t load_cart(char *cart_path_p) {
+  u32 rom_size_bytes;
+
+  /* Raw ROMs and .gz/.zip archives alike */
+  if (!rom_file_size(cart_path_p, &rom_size_bytes)) {
+    printf("Error opening file: %s\n", cart_path_p);
+    exit(1);
+  }
+
+  u8 *rom_p = malloc(rom_size_bytes);
+
+  if (!rom_file_read(cart_path_p, rom_p, rom_size_bytes) ||
+      !cart_parse(&ctx, cart_path_p, rom_p, rom_size_bytes)) {
+    printf("Error reading file: %s\n", cart_path_p);
+    exit(1);
+  }
 
   return ctx;
 };
 
+/**
+ * @brief Release the ROM buffer of a cartridge returned by load_cart()
+ * @param cart_p Cartridge
+ */
+void unload_cart(cart_t *cart_p) {
+  /* print_cart_metadata() must not use the freed buffer */
+  if (ctx.rom_p == cart_p->rom_p) {
+    ctx.rom_p = NULL;
+  }
+
+  free(cart_p->rom_p);
+  cart_p->rom_p = NULL;
+}
+
 /**
  * @brief Format cart metadata into a string
  * @param buf_p Buffer to store the formatted metadata
@@ -351,7 +390,13 @@ void format_cart_metadata(char *buf_p, size_t buflen,
  */
 void print_cart_metadata() {
   char metadata_buf[1024];
-  format_cart_metadata(metadata_buf, sizeof(metadata_buf), *ctx.metadata);
+
+  if (ctx.rom_p == NULL) {
+    printf("No cartridge loaded\n");
+    return;
+  }
+
+  format_cart_metadata(metadata_buf, sizeof(metadata_buf), ctx.metadata);
 
   printf("%s\n", metadata_buf);
 };
@@ -417,3 +462,19 @@ void get_human_rom_size(char *buf_p, size_t buflen, u8 rom_size_code) {
  * @return The RAM size in KiB
  */
 int get_ram_size_kib(u8 ram_size_code) { return RAM_SIZES_KIB[ram_size_code]; };
+
+/**
+ * @brief Size of the cartridge RAM declared in the header
+ * @param metadata_p Cartridge metadata
+ * @return The size in bytes, 0 for no RAM or an unknown RAM size code
+ */
+u32 cart_ram_size_bytes(const cart_metadata_t *metadata_p) {
+  u8 code = metadata_p->ram_size_code;
+
+  if (code >= sizeof(RAM_SIZES_KIB) / sizeof(RAM_SIZES_KIB[0]) ||
+      RAM_SIZES_KIB[code] < 0) {
+    return 0;
+  }
+
+  return RAM_SIZES_KIB[code] * 1024;
+}
@@ -2,15 +2,60 @@
 
 cpu_ctx_t ctx = {};
 
+/**
+ * @brief Reset the CPU to its state after the boot ROM
+ * @param ctx_p CPU context, NULL for the emulator's own
+ */
 void cpu_init(cpu_ctx_t *ctx_p) {
   /* Allows passing a test context in the test suite */
   if (!ctx_p) {
     ctx_p = &ctx;
   }
 
-  /* Instructions start at 0x100 in carts */
-  ctx_p->regs.pc = 0x100;
-  /* https://gbdev.io/pandocs/Power_Up_Sequence.html#monochrome-models-dmg0-dmg-mgb
-   */
-  ctx_p->regs.a = 0x01;
+  /* Registers as left by the boot ROM, see
+   * https://gbdev.io/pandocs/Power_Up_Sequence.html#monochrome-models-dmg0-dmg-mgb
+   * F assumes a non-zero header checksum, see boot_skip(). */
+  ctx_p->regs = (registers_t){
+      .a = 0x01,
+      .f = 0xB0,
+      .b = 0x00,
+      .c = 0x13,
+      .d = 0x00,
+      .e = 0xD8,
+      .h = 0x01,
+      .l = 0x4D,
+      .sp = 0xFFFE,
+      /* Instructions start at 0x100 in carts */
+      .pc = 0x100,
+  };
+  ctx_p->cycles = 0;
+  ctx_p->ime = false;
+  ctx_p->halted = false;
+  ctx_p->stopped = false;
+  ctx_p->halt_bug = false;
 }
+
+/**
+ * @brief Execute HALT
+ * @param ctx_p CPU context
+ * @param ie IE register
+ * @param if_reg IF register
+ *
+ * With IME off and an interrupt already pending the CPU does not halt, and
+ * instead fails to increment PC after reading the next opcode (halt bug,
+ * https://gbdev.io/pandocs/halt.html#halt-bug).
+ */
+void cpu_halt(cpu_ctx_t *ctx_p, u8 ie, u8 if_reg) {
+  if (!ctx_p->ime && (ie & if_reg & INT_MASK)) {
+    ctx_p->halt_bug = true;
+    return;
+  }
+
+  ctx_p->halted = true;
+}
+
+/**
+ * @brief Execute STOP, which sleeps until a button is pressed
+ * @param ctx_p CPU context
+ */
+void cpu_stop(cpu_ctx_t *ctx_p) { ctx_p->stopped = true; }
@@ -0,0 +1,162 @@
+/**
+ * @file dma.c
+ * @brief OAM DMA transfers
+ * @author Coaxial
+ * @date 2026-10-19
+ *
+ * A transfer copies 160 bytes from page XX00 to OAM over 640 cycles. Rather
+ * than copying a byte per M-cycle, the copy happens in one go when the
+ * transfer completes on the scheduler timeline, and CPU accesses in between
+ * are resolved from the transfer's start time.
+ * https://gbdev.io/pandocs/OAM_DMA_Transfer.html
+ */
+
+#include "dma.h"
+
+/**
+ * @brief Copy the source into OAM when the transfer completes
+ * @param user_p The DMA state
+ * @param when Completion cycle, unused: the copy does not depend on it
+ */
+static void dma_complete(void *user_p, u64 when) {
+  dma_t *dma_p = user_p;
+  (void)when;
+
+  if (dma_p->source_p) {
+    memcpy(dma_p->mem_p->oam, dma_p->source_p, OAM_SIZE);
+  } else {
+    memset(dma_p->mem_p->oam, 0xFF, OAM_SIZE);
+  }
+
+  dma_p->active = false;
+  sprite_cache_invalidate(dma_p->sprites_p);
+}
+
+/**
+ * @brief Set up the DMA state and hook it to the scheduler
+ * @param dma_p DMA state
+ * @param sched_p Scheduler
+ * @param mem_p Guest memory
+ * @param sprites_p Sprite cache, invalidated by every transfer
+ */
+void dma_init(dma_t *dma_p, sched_t *sched_p, mem_t *mem_p,
+              sprite_cache_t *sprites_p) {
+  *dma_p = (dma_t){.mem_p = mem_p, .sprites_p = sprites_p};
+  sched_set_handler(sched_p, SCHED_EVENT_DMA, dma_complete, dma_p);
+}
+
+/**
+ * @brief Resolve a DMA source page to host memory
+ * @param mem_p Guest memory
+ * @param cart_p Inserted cartridge
+ * @param page High byte of the source address
+ * @return The 160 source bytes, or NULL if the page is not backed by memory
+ */
+const u8 *dma_source(const mem_t *mem_p, const cart_t *cart_p, u8 page) {
+  u16 addr = page << 8;
+
+  /* ROM pages map linearly, as on a cartridge without an MBC */
+  if (addr < 0x8000) {
+    if (cart_p && (u32)addr + OAM_SIZE <= cart_p->rom_size_bytes) {
+      return cart_p->rom_p + addr;
+    }
+    return NULL;
+  }
+
+  if (BETWEEN(addr, VRAM_START, VRAM_START + VRAM_SIZE - 1)) {
+    return mem_p->vram + (addr - VRAM_START);
+  }
+
+  /* 0xE000-0xFDFF mirrors WRAM, and so do pages 0xFE and 0xFF on DMG */
+  if (addr >= WRAM_START) {
+    return mem_p->wram + ((addr - WRAM_START) % WRAM_SIZE);
+  }
+
+  /* Cartridge RAM, bank 0 as on a cartridge without an MBC */
+  u32 offset = addr - CART_RAM_START;
+  if (cart_p && cart_p->ram_p && offset + OAM_SIZE <= cart_p->ram_size_bytes) {
+    return cart_p->ram_p + offset;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Start a transfer, as done by writing to FF46
+ * @param dma_p DMA state
+ * @param sched_p Scheduler
+ * @param cart_p Inserted cartridge
+ * @param page Value written to FF46
+ * @param now Current cycle
+ *
+ * Starting a transfer while one is running restarts it from the new source.
+ */
+void dma_start(dma_t *dma_p, sched_t *sched_p, const cart_t *cart_p, u8 page,
+               u64 now) {
+  dma_p->mem_p->io[REG_DMA] = page;
+  dma_p->source_p = dma_source(dma_p->mem_p, cart_p, page);
+  /* Pages 0xE0-0xFF read the WRAM they mirror, on the external bus */
+  dma_p->bus = page >= 0xE0 ? DMA_BUS_EXTERNAL : dma_bus(page << 8);
+  dma_p->start = now;
+  dma_p->active = true;
+
+  sched_add(sched_p, SCHED_EVENT_DMA, now + DMA_CYCLES, 0, 0);
+}
+
+/**
+ * @brief Bus an address is reached through
+ * @param addr Address
+ * @return The bus
+ */
+dma_bus_t dma_bus(u16 addr) {
+  if (BETWEEN(addr, VRAM_START, VRAM_START + VRAM_SIZE - 1)) {
+    return DMA_BUS_VIDEO;
+  }
+  if (addr >= IO_START) {
+    return DMA_BUS_INTERNAL;
+  }
+  if (addr >= OAM_START) {
+    return DMA_BUS_OAM;
+  }
+
+  return DMA_BUS_EXTERNAL;
+}
+
+/**
+ * @brief Whether a CPU access collides with a running transfer
+ * @param dma_p DMA state
+ * @param addr Address accessed by the CPU
+ * @param now Current cycle
+ * @return true if the access cannot reach its target; reads then return
+ * dma_conflict_value() and writes are dropped
+ *
+ * OAM is busy being written, and the bus the source is read from is busy
+ * too. The other bus, I/O and HRAM stay reachable, as does everything during
+ * the setup M-cycle.
+ * https://gbdev.io/pandocs/OAM_DMA_Transfer.html
+ */
+bool dma_bus_conflict(const dma_t *dma_p, u16 addr, u64 now) {
+  if (!dma_p->active || now < dma_p->start + DMA_SETUP_CYCLES) {
+    return false;
+  }
+
+  dma_bus_t bus = dma_bus(addr);
+  return bus == DMA_BUS_OAM || bus == dma_p->bus;
+}
+
+/**
+ * @brief Value read by the CPU when its access collides with the transfer
+ * @param dma_p DMA state
+ * @param addr Address read by the CPU
+ * @param now Current cycle
+ * @return 0xFF for OAM, otherwise the byte the DMA is reading from the shared
+ * bus at this cycle
+ */
+u8 dma_conflict_value(const dma_t *dma_p, u16 addr, u64 now) {
+  u64 index = (now - dma_p->start - DMA_SETUP_CYCLES) / 4;
+
+  if (dma_bus(addr) == DMA_BUS_OAM || !dma_p->source_p || index >= OAM_SIZE) {
+    return 0xFF;
+  }
+
+  return dma_p->source_p[index];
+}
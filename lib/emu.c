@@ -5,20 +5,136 @@
  * @date 2025-06-03
  */
 
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 #include "emu.h"
-#include "cart.h"
-#include "cpu.h"
+#include "boot.h"
+#include "rom_file.h"
+
+static size_t align_up(size_t size) {
+  return (size + EMU_ARENA_ALIGN - 1) & ~(size_t)(EMU_ARENA_ALIGN - 1);
+}
+
+static void *arena_alloc(size_t size) {
+#ifdef _WIN32
+  return _aligned_malloc(size, EMU_ARENA_ALIGN);
+#else
+  void *arena_p;
+  return posix_memalign(&arena_p, EMU_ARENA_ALIGN, size) == 0 ? arena_p : NULL;
+#endif
+}
+
+static void arena_free(void *arena_p) {
+#ifdef _WIN32
+  _aligned_free(arena_p);
+#else
+  free(arena_p);
+#endif
+}
+
+/**
+ * @brief Create an emulator instance, booted and ready to run a ROM
+ * @param rom_path_p Path to a raw ROM, or a .gz/.zip archive holding one
+ * @return The instance, or NULL if the ROM cannot be loaded
+ *
+ * The instance, guest memory, cartridge RAM and ROM share a single allocation
+ * laid out as [emu_t | mem_t | cart RAM | ROM], each region starting on a page
+ * boundary. The header is only known once the ROM is read, so the cartridge
+ * RAM region is sized for the largest cartridge; the pages past what the
+ * cartridge uses are never touched.
+ */
+emu_t *emu_create(const char *rom_path_p) {
+  u32 rom_size_bytes;
+
+  if (!rom_file_size(rom_path_p, &rom_size_bytes)) {
+    printf("Error opening file: %s\n", rom_path_p);
+    return NULL;
+  }
+
+  size_t emu_bytes = align_up(sizeof(emu_t));
+  size_t mem_bytes = align_up(sizeof(mem_t));
+  size_t ram_bytes = align_up(CART_RAM_MAX_BYTES);
+  size_t arena_bytes =
+      emu_bytes + mem_bytes + ram_bytes + align_up(rom_size_bytes);
+  u8 *arena_p = arena_alloc(arena_bytes);
+
+  if (arena_p == NULL) {
+    printf("Out of memory loading %s\n", rom_path_p);
+    return NULL;
+  }
+
+  /* The ROM is fully overwritten, and the cartridge RAM cleared once its
+   * size is known */
+  memset(arena_p, 0, emu_bytes + mem_bytes);
+
+  emu_t *emu_p = (emu_t *)arena_p;
+  u8 *ram_p = arena_p + emu_bytes + mem_bytes;
+  u8 *rom_p = ram_p + ram_bytes;
+  emu_p->mem_p = (mem_t *)(arena_p + emu_bytes);
+  emu_p->arena_bytes = arena_bytes;
+
+  if (!rom_file_read(rom_path_p, rom_p, rom_size_bytes) ||
+      !cart_parse(&emu_p->cart, rom_path_p, rom_p, rom_size_bytes)) {
+    printf("Error reading file: %s\n", rom_path_p);
+    arena_free(arena_p);
+    return NULL;
+  }
+
+  emu_p->cart.ram_p = ram_p;
+  emu_p->cart.ram_size_bytes = cart_ram_size_bytes(&emu_p->cart.metadata);
+  memset(ram_p, 0, emu_p->cart.ram_size_bytes);
+
+  sched_init(&emu_p->sched);
+  sprite_cache_init(&emu_p->sprites);
+  dma_init(&emu_p->dma, &emu_p->sched, emu_p->mem_p, &emu_p->sprites);
+  link_init(&emu_p->link, &emu_p->sched, emu_p->mem_p);
+  boot_skip(&emu_p->cpu, emu_p->mem_p, &emu_p->cart.metadata);
+
+  return emu_p;
+}
+
+/**
+ * @brief Release an emulator instance and everything it owns, unplugging its
+ * link cable
+ * @param emu_p Instance from emu_create(), may be NULL
+ */
+void emu_destroy(emu_t *emu_p) {
+  if (emu_p) {
+    link_disconnect(&emu_p->link);
+  }
+
+  arena_free(emu_p);
+}
 
 int emu_run(int argc, char *argv[]) {
   if (argc < 2) {
-    printf("Usage: emu <rom_file>\n");
+    printf("Usage: emu <rom_file> [boot_rom_file]\n");
+    return -1;
+  }
+
+  emu_t *emu_p = emu_create(argv[1]);
+
+  if (emu_p == NULL) {
     return -1;
   }
 
-  cart_t cart = load_cart(argv[1]);
-  print_cart_metadata();
+  char metadata_buf[1024];
+  format_cart_metadata(metadata_buf, sizeof(metadata_buf),
+                       emu_p->cart.metadata);
+  printf("%s\n", metadata_buf);
 
-  cpu_init(NULL);
+  int result = 0;
+
+  if (argc > 2) {
+    if (boot_rom_load(emu_p->mem_p, argv[2])) {
+      boot_from_rom(&emu_p->cpu, emu_p->mem_p);
+    } else {
+      result = -1;
+    }
+  }
 
-  return 0;
+  emu_destroy(emu_p);
+  return result;
 }
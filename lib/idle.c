@@ -0,0 +1,227 @@
+/**
+ * @file idle.c
+ * @brief Fast-forwarding over cycles where the CPU only waits for hardware
+ * @author Coaxial
+ * @date 2026-10-19
+ *
+ * Games spend a large part of each frame halted or spinning on LY/STAT until
+ * the PPU reaches a given line. Nothing observable happens during that time
+ * besides scheduled events, so the cycle counter can jump from one event to
+ * the next instead of executing the wait one instruction at a time.
+ */
+
+#include "idle.h"
+
+/* Opcodes making up polling loops, with their T-cycle counts */
+#define OP_LDH_A_A8 0xF0
+#define OP_LD_A_A16 0xFA
+#define OP_CP_D8 0xFE
+#define OP_AND_D8 0xE6
+#define OP_JR_NZ 0x20
+#define OP_JR_Z 0x28
+#define OP_JR_NC 0x30
+#define OP_JR_C 0x38
+
+static const u8 LDH_CYCLES = 12;
+static const u8 LD_A16_CYCLES = 16;
+static const u8 ALU_D8_CYCLES = 8;
+static const u8 JR_TAKEN_CYCLES = 12;
+
+/**
+ * @brief Sleep through HALT or STOP until an interrupt wakes the CPU
+ * @param ctx_p CPU context
+ * @param mem_p Guest memory
+ * @param sched_p Scheduler, events are fired as the cycle count reaches them
+ * @param limit Cycle to stop at if nothing wakes the CPU before
+ * @return true if the CPU is awake, false if it is still asleep at `limit` or
+ * when a handler stopped the scheduler
+ *
+ * HALT ends as soon as an enabled interrupt is pending, whatever IME is. STOP
+ * only ends on a joypad press.
+ */
+bool idle_skip_halt(cpu_ctx_t *ctx_p, mem_t *mem_p, sched_t *sched_p,
+                    u64 limit) {
+  u8 *if_p = &mem_p->io[REG_IF];
+
+  while (ctx_p->halted || ctx_p->stopped) {
+    bool wake = ctx_p->stopped ? (*if_p & INT_JOYPAD)
+                               : (*if_p & mem_p->ie & INT_MASK);
+    if (wake) {
+      ctx_p->halted = false;
+      ctx_p->stopped = false;
+      break;
+    }
+
+    if (sched_p->stop) {
+      return false;
+    }
+
+    u64 next = sched_next(sched_p, NULL);
+    if (next >= limit) {
+      if (ctx_p->cycles < limit) {
+        ctx_p->cycles = limit;
+      }
+      return false;
+    }
+
+    if (next > ctx_p->cycles) {
+      ctx_p->cycles = next;
+    }
+    sched_fire_due(sched_p, ctx_p->cycles, if_p);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Recognize a loop polling LY, STAT or IF at the current PC
+ * @param code_p Bytes at PC
+ * @param len Number of bytes available at code_p
+ * @param loop_p Filled with the loop description when one is found
+ * @return true if the code at PC is a polling loop jumping back to PC
+ */
+bool idle_detect_poll(const u8 *code_p, size_t len, idle_loop_t *loop_p) {
+  size_t i = 0;
+  u8 cycles;
+
+  if (len >= 2 && code_p[0] == OP_LDH_A_A8) {
+    loop_p->reg = code_p[1];
+    cycles = LDH_CYCLES;
+    i = 2;
+  } else if (len >= 3 && code_p[0] == OP_LD_A_A16 && code_p[2] == 0xFF &&
+             code_p[1] < IO_SIZE) {
+    loop_p->reg = code_p[1];
+    cycles = LD_A16_CYCLES;
+    i = 3;
+  } else {
+    return false;
+  }
+
+  if (loop_p->reg != REG_LY && loop_p->reg != REG_STAT &&
+      loop_p->reg != REG_IF) {
+    return false;
+  }
+
+  if (len < i + 4) {
+    return false;
+  }
+
+  u8 alu = code_p[i];
+  u8 jr = code_p[i + 2];
+  /* The jump must land back on the load */
+  int offset = (int8_t)code_p[i + 3];
+  if (offset != -(int)(i + 4)) {
+    return false;
+  }
+
+  if (alu == OP_CP_D8) {
+    loop_p->mask = 0xFF;
+    loop_p->operand = code_p[i + 1];
+  } else if (alu == OP_AND_D8 && (jr == OP_JR_NZ || jr == OP_JR_Z)) {
+    /* AND clears carry, so only Z based loops can exit */
+    loop_p->mask = code_p[i + 1];
+    loop_p->operand = 0;
+  } else {
+    return false;
+  }
+
+  switch (jr) {
+  case OP_JR_NZ:
+    loop_p->exit = IDLE_EXIT_EQUAL;
+    break;
+  case OP_JR_Z:
+    loop_p->exit = IDLE_EXIT_NOT_EQUAL;
+    break;
+  case OP_JR_C:
+    loop_p->exit = IDLE_EXIT_GREATER_OR_EQUAL;
+    break;
+  case OP_JR_NC:
+    loop_p->exit = IDLE_EXIT_LESS;
+    break;
+  default:
+    return false;
+  }
+
+  loop_p->iteration_cycles = cycles + ALU_D8_CYCLES + JR_TAKEN_CYCLES;
+  return true;
+}
+
+/**
+ * @brief Whether a polling loop exits when reading a given value
+ * @param loop_p Loop description
+ * @param value Value of the polled register
+ * @return true if the loop falls through on this value
+ */
+bool idle_poll_exits(const idle_loop_t *loop_p, u8 value) {
+  u8 masked = value & loop_p->mask;
+
+  switch (loop_p->exit) {
+  case IDLE_EXIT_EQUAL:
+    return masked == loop_p->operand;
+  case IDLE_EXIT_NOT_EQUAL:
+    return masked != loop_p->operand;
+  case IDLE_EXIT_GREATER_OR_EQUAL:
+    return masked >= loop_p->operand;
+  case IDLE_EXIT_LESS:
+    return masked < loop_p->operand;
+  default:
+    return true;
+  }
+}
+
+/**
+ * @brief Fast-forward a polling loop until its register changes to a value
+ * that ends it
+ * @param ctx_p CPU context, with PC on the first instruction of the loop
+ * @param mem_p Guest memory
+ * @param sched_p Scheduler, events are fired as the cycle count reaches them
+ * @param loop_p Loop found by idle_detect_poll()
+ * @param limit Cycle not to skip past
+ * @return Number of cycles skipped
+ *
+ * The cycle count only moves by whole iterations, and PC stays on the loop so
+ * the interpreter executes the final iteration itself, reading the new value
+ * and setting A and the flags as the real loop would. It also stops when an
+ * interrupt is about to be serviced or a handler stopped the scheduler.
+ */
+u64 idle_skip_poll(cpu_ctx_t *ctx_p, mem_t *mem_p, sched_t *sched_p,
+                   const idle_loop_t *loop_p, u64 limit) {
+  u8 *if_p = &mem_p->io[REG_IF];
+  u64 start = ctx_p->cycles;
+  u64 iteration = loop_p->iteration_cycles;
+
+  while (!idle_poll_exits(loop_p, mem_p->io[loop_p->reg])) {
+    if (ctx_p->ime && (*if_p & mem_p->ie & INT_MASK)) {
+      break;
+    }
+
+    if (sched_p->stop) {
+      break;
+    }
+
+    u64 next = sched_next(sched_p, NULL);
+    u64 target = next < limit ? next : limit;
+
+    if (target <= ctx_p->cycles) {
+      if (next > ctx_p->cycles) {
+        break;
+      }
+    } else {
+      /* Round up to reach the event, but never go past the limit. Divide
+       * first: the limit can be SCHED_NEVER. */
+      u64 gap = target - ctx_p->cycles;
+      u64 iterations = gap / iteration + (gap % iteration != 0);
+      if (iterations > (limit - ctx_p->cycles) / iteration) {
+        iterations = (limit - ctx_p->cycles) / iteration;
+      }
+      if (iterations == 0) {
+        break;
+      }
+      ctx_p->cycles += iterations * iteration;
+    }
+
+    sched_fire_due(sched_p, ctx_p->cycles, if_p);
+  }
+
+  return ctx_p->cycles - start;
+}
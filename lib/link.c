@@ -0,0 +1,410 @@
+/**
+ * @file link.c
+ * @brief Link cable between emulator instances
+ * @author Coaxial
+ * @date 2026-10-19
+ *
+ * The instance clocking a transfer posts its byte and completion time in its
+ * port. The peer answers from link_poll() or its scheduler's link event once
+ * its own clock reaches the completion time. When the transfer completes
+ * before the peer answered, the instance waits, see link_waiting(). Both
+ * instances therefore run freely between transfers and are synchronized at
+ * transfer boundaries only.
+ * https://gbdev.io/pandocs/Serial_Data_Transfer_(Link_Cable).html
+ */
+
+#include <errno.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "cpu.h"
+#include "link.h"
+
+/* What an unconnected or idle peer shifts in */
+static const u8 NO_PEER_DATA = 0xFF;
+
+static link_port_t *own_port(const link_t *link_p) {
+  return &link_p->cable_p->ports[link_p->port];
+}
+
+static link_port_t *peer_port(const link_t *link_p) {
+  return &link_p->cable_p->ports[1 - link_p->port];
+}
+
+static int own_pid(void) {
+#ifdef _WIN32
+  return _getpid();
+#else
+  return getpid();
+#endif
+}
+
+/**
+ * @brief Tell whether the process owning a port still runs
+ * @param pid Owner, 0 for a free port
+ * @return true if the process exists
+ */
+static bool pid_alive(int pid) {
+  if (pid == 0) {
+    return false;
+  }
+
+#ifdef _WIN32
+  /* Cables are only shared within a process on Windows */
+  return true;
+#else
+  /* EPERM means the process exists but belongs to another user */
+  return kill(pid, 0) == 0 || errno != ESRCH;
+#endif
+}
+
+/**
+ * @brief Bring the link event forward
+ * @param link_p Link
+ * @param when Cycle to serve the peer at
+ */
+static void poll_at(link_t *link_p, u64 when) {
+  if (when < link_p->sched_p->events[SCHED_EVENT_LINK].when) {
+    sched_add(link_p->sched_p, SCHED_EVENT_LINK, when, 0, 0);
+  }
+}
+
+/**
+ * @brief End a transfer on this instance
+ * @param mem_p Guest memory
+ * @param received Byte shifted in
+ */
+static void complete_transfer(mem_t *mem_p, u8 received) {
+  mem_p->io[REG_SB] = received;
+  mem_p->io[REG_SC] &= ~SC_TRANSFER;
+  mem_p->io[REG_IF] |= INT_SERIAL;
+}
+
+/**
+ * @brief Answer the peer's pending transfer, if any
+ * @param link_p Link
+ * @param now Current cycle
+ * @param force Answer even if this instance has not reached the completion
+ * time yet
+ *
+ * A transfer that is not due yet brings the link event forward to its
+ * completion time, so that skipping idle cycles stops there.
+ */
+static void answer_peer(link_t *link_p, u64 now, bool force) {
+  link_port_t *own_p = own_port(link_p);
+  link_port_t *peer_p = peer_port(link_p);
+  u32 seq = atomic_load_explicit(&peer_p->seq, memory_order_acquire);
+
+  if (seq == link_p->answered) {
+    return;
+  }
+
+  u64 due = link_p->base +
+            atomic_load_explicit(&peer_p->done_at, memory_order_relaxed);
+
+  if (!force && now < due) {
+    poll_at(link_p, due);
+    return;
+  }
+
+  u8 *sc_p = &link_p->mem_p->io[REG_SC];
+  u8 reply = NO_PEER_DATA;
+
+  /* Only shift if a transfer waits on the external clock, see below for
+   * both ends clocking at once */
+  if (*sc_p & SC_TRANSFER) {
+    reply = link_p->mem_p->io[REG_SB];
+    if (!(*sc_p & SC_INTERNAL_CLOCK)) {
+      complete_transfer(link_p->mem_p,
+                        atomic_load_explicit(&peer_p->data,
+                                             memory_order_relaxed));
+    }
+  }
+
+  link_p->answered = seq;
+  atomic_store_explicit(&own_p->reply, reply, memory_order_relaxed);
+  atomic_store_explicit(&own_p->ack, seq, memory_order_release);
+}
+
+/**
+ * @brief Finish the transfer this instance is waiting on, if possible
+ * @param link_p Link, waiting
+ *
+ * The transfer shifts in 0xFF if the peer unplugged or its process died.
+ */
+static void finish_waiting(link_t *link_p) {
+  link_port_t *peer_p = peer_port(link_p);
+
+  if (atomic_load_explicit(&peer_p->ack, memory_order_acquire) ==
+      link_p->seq) {
+    link_p->waiting = false;
+    link_p->sched_p->stop = false;
+    complete_transfer(link_p->mem_p, atomic_load_explicit(
+                                         &peer_p->reply, memory_order_relaxed));
+  } else if (!atomic_load(&peer_p->attached) ||
+             !pid_alive(atomic_load(&peer_p->owner_pid))) {
+    link_p->waiting = false;
+    link_p->sched_p->stop = false;
+    complete_transfer(link_p->mem_p, NO_PEER_DATA);
+  }
+}
+
+/**
+ * @brief Reach the end of a transfer clocked by this instance
+ * @param user_p Link
+ * @param when Completion cycle
+ *
+ * The transfer completes right away if the peer already answered it, and
+ * otherwise leaves the instance waiting and sets sched_t.stop, so that
+ * skipping idle cycles does not run past the transfer. While waiting,
+ * transfers clocked by the peer are answered right away so that two
+ * instances clocking at once cannot deadlock: each receives the other's byte.
+ */
+static void transfer_done(void *user_p, u64 when) {
+  link_t *link_p = user_p;
+
+  if (!link_p->cable_p) {
+    complete_transfer(link_p->mem_p, NO_PEER_DATA);
+    return;
+  }
+
+  /* A peer transfer due by now still sees this transfer in progress */
+  answer_peer(link_p, when, false);
+  link_p->waiting = true;
+  link_p->sched_p->stop = true;
+  finish_waiting(link_p);
+}
+
+/**
+ * @brief Serve the peer while this instance runs or sleeps
+ * @param user_p Link
+ * @param when Cycle the event was due
+ *
+ * Polls every LINK_POLL_CYCLES, sooner if a peer transfer is due before.
+ */
+static void link_event(void *user_p, u64 when) {
+  link_t *link_p = user_p;
+
+  sched_add(link_p->sched_p, SCHED_EVENT_LINK, when + LINK_POLL_CYCLES, 0, 0);
+  link_poll(link_p, when);
+}
+
+/**
+ * @brief Create a cable for instances in this process
+ * @return The cable, or NULL if out of memory
+ */
+link_cable_t *link_cable_create(void) {
+  return calloc(1, sizeof(link_cable_t));
+}
+
+/**
+ * @brief Free a cable from link_cable_create()
+ * @param cable_p Cable, both ends disconnected
+ */
+void link_cable_destroy(link_cable_t *cable_p) { free(cable_p); }
+
+/**
+ * @brief Open or create a cable shared between processes
+ * @param name_p Shared memory object name, starting with a slash
+ * @return The mapped cable, or NULL on failure
+ */
+link_cable_t *link_cable_open_shared(const char *name_p) {
+#ifdef _WIN32
+  printf("Shared memory link cables are not supported on Windows\n");
+  return NULL;
+#else
+  /* A new object is zero-filled by ftruncate(), which is a valid empty
+   * cable */
+  int fd = shm_open(name_p, O_RDWR | O_CREAT, 0600);
+
+  if (fd < 0) {
+    printf("Error opening link cable: %s\n", name_p);
+    return NULL;
+  }
+
+  if (ftruncate(fd, sizeof(link_cable_t)) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  void *cable_p = mmap(NULL, sizeof(link_cable_t), PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+  close(fd);
+
+  return cable_p == MAP_FAILED ? NULL : cable_p;
+#endif
+}
+
+/**
+ * @brief Unmap a cable from link_cable_open_shared()
+ * @param cable_p Cable, disconnected
+ */
+void link_cable_close_shared(link_cable_t *cable_p) {
+#ifndef _WIN32
+  munmap(cable_p, sizeof(link_cable_t));
+#endif
+}
+
+/**
+ * @brief Remove a shared cable's name, once every process is done with it
+ * @param name_p Shared memory object name
+ */
+void link_cable_unlink_shared(const char *name_p) {
+#ifndef _WIN32
+  shm_unlink(name_p);
+#endif
+}
+
+/**
+ * @brief Set up the serial port, unconnected
+ * @param link_p Link
+ * @param sched_p Scheduler, whose serial and link events complete and answer
+ * transfers
+ * @param mem_p Guest memory
+ */
+void link_init(link_t *link_p, sched_t *sched_p, mem_t *mem_p) {
+  *link_p = (link_t){.mem_p = mem_p, .sched_p = sched_p};
+  sched_set_handler(sched_p, SCHED_EVENT_SERIAL, transfer_done, link_p);
+  sched_set_handler(sched_p, SCHED_EVENT_LINK, link_event, link_p);
+}
+
+/**
+ * @brief Plug into a free end of a cable
+ * @param link_p Link
+ * @param cable_p Cable
+ * @param now Current cycle
+ * @return true if connected, false if both ends are taken
+ *
+ * An end left plugged by a process that died is reclaimed.
+ */
+bool link_connect(link_t *link_p, link_cable_t *cable_p, u64 now) {
+  int pid = own_pid();
+
+  for (int port = 0; port < 2; port++) {
+    link_port_t *port_p = &cable_p->ports[port];
+    link_port_t *peer_p = &cable_p->ports[1 - port];
+    int owner = atomic_load(&port_p->owner_pid);
+
+    if (pid_alive(owner) ||
+        !atomic_compare_exchange_strong(&port_p->owner_pid, &owner, pid)) {
+      continue;
+    }
+
+    /* Start in sync with whatever the peer already answered */
+    link_p->seq = atomic_load(&peer_p->ack);
+    link_p->answered = atomic_load(&peer_p->seq);
+    atomic_store(&port_p->seq, link_p->seq);
+    atomic_store(&port_p->ack, link_p->answered);
+    atomic_store(&port_p->attached, true);
+
+    link_p->cable_p = cable_p;
+    link_p->port = port;
+    link_p->base = now;
+    link_p->waiting = false;
+    sched_add(link_p->sched_p, SCHED_EVENT_LINK, now + LINK_POLL_CYCLES, 0,
+              0);
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * @brief Unplug from the cable, a peer waiting on this end stops waiting
+ * @param link_p Link
+ *
+ * A transfer this instance was waiting on shifts in 0xFF.
+ */
+void link_disconnect(link_t *link_p) {
+  if (link_p->cable_p) {
+    link_port_t *own_p = own_port(link_p);
+
+    atomic_store(&own_p->attached, false);
+    atomic_store(&own_p->owner_pid, 0);
+    link_p->cable_p = NULL;
+    sched_cancel(link_p->sched_p, SCHED_EVENT_LINK);
+  }
+
+  if (link_p->waiting) {
+    link_p->waiting = false;
+    link_p->sched_p->stop = false;
+    complete_transfer(link_p->mem_p, NO_PEER_DATA);
+  }
+}
+
+/**
+ * @brief Handle a write to SC
+ * @param link_p Link
+ * @param value Value written
+ * @param now Current cycle
+ *
+ * Starting a transfer with the internal clock posts SB to the peer and
+ * schedules its completion. With the external clock, the transfer waits for
+ * the peer to clock it, see link_poll().
+ */
+void link_serial_control(link_t *link_p, u8 value, u64 now) {
+  /* Unused SC bits read back as 1 on DMG */
+  link_p->mem_p->io[REG_SC] = value | 0x7E;
+
+  if ((value & (SC_TRANSFER | SC_INTERNAL_CLOCK)) !=
+      (SC_TRANSFER | SC_INTERNAL_CLOCK)) {
+    return;
+  }
+
+  if (link_p->cable_p) {
+    link_port_t *own_p = own_port(link_p);
+
+    link_p->seq++;
+    atomic_store_explicit(&own_p->data, link_p->mem_p->io[REG_SB],
+                          memory_order_relaxed);
+    atomic_store_explicit(&own_p->done_at,
+                          now - link_p->base + LINK_TRANSFER_CYCLES,
+                          memory_order_relaxed);
+    atomic_store_explicit(&own_p->seq, link_p->seq, memory_order_release);
+  }
+
+  sched_add(link_p->sched_p, SCHED_EVENT_SERIAL, now + LINK_TRANSFER_CYCLES,
+            0, 0);
+}
+
+/**
+ * @brief Serve the peer, and finish a transfer this instance waits on
+ * @param link_p Link
+ * @param now Current cycle
+ *
+ * Meant to be called often (every instruction or event), and only loads the
+ * peer's seq when nothing is pending. The link event calls it while the CPU
+ * sleeps.
+ */
+void link_poll(link_t *link_p, u64 now) {
+  if (!link_p->cable_p) {
+    return;
+  }
+
+  answer_peer(link_p, now, link_p->waiting);
+
+  if (link_p->waiting) {
+    finish_waiting(link_p);
+  }
+}
+
+/**
+ * @brief Tell whether a transfer clocked by this instance waits on the peer
+ * @param link_p Link
+ * @return true until the peer answers, unplugs or dies
+ *
+ * A waiting instance must not run any further: keep calling link_poll()
+ * instead, which answers the peer meanwhile. Instances on one thread must
+ * take turns (poll the waiting one, step the other), instances on separate
+ * threads or processes simply poll until it returns false. The SERIAL
+ * interrupt is raised when the wait ends. Idle skips return early while it
+ * waits, see sched_t.stop.
+ */
+bool link_waiting(const link_t *link_p) { return link_p->waiting; }
@@ -0,0 +1,679 @@
+/**
+ * @file rom_file.c
+ * @brief Reading ROM images, raw or from .gz/.zip archives
+ * @author Coaxial
+ * @date 2026-10-19
+ *
+ * Archives are inflated straight into the ROM buffer, without temporary
+ * files. When ROM_CACHE_ENV is set, the decompressed image is stored in a
+ * content-addressed cache, named after the header's global checksum and a
+ * hash of the data, and later loads of the same archive read it back
+ * directly.
+ *
+ * Builds without zlib (GBEMU_NO_ZLIB) only load raw ROMs.
+ */
+
+#include <sys/stat.h>
+
+#ifndef GBEMU_NO_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <unistd.h>
+#endif
+
+#include "rom_file.h"
+
+#define CHUNK_BYTES 16384
+#define CACHE_PATH_BYTES 2048
+
+/* FNV-1a 64-bit, see http://www.isthe.com/chongo/tech/comp/fnv/ */
+static const u64 FNV64_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+static const u64 FNV64_PRIME = 0x100000001B3ULL;
+
+static const u8 GZIP_MAGIC[] = {0x1F, 0x8B};
+static const u8 ZIP_MAGIC[] = {'P', 'K', 0x03, 0x04};
+static const u8 SEVEN_ZIP_MAGIC[] = {'7', 'z', 0xBC, 0xAF, 0x27, 0x1C};
+
+/* https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT */
+static const u32 ZIP_END_OF_CENTRAL_DIR_SIG = 0x06054B50;
+static const u32 ZIP_CENTRAL_DIR_SIG = 0x02014B50;
+static const int ZIP_END_OF_CENTRAL_DIR_BYTES = 22;
+static const int ZIP_CENTRAL_DIR_ENTRY_BYTES = 46;
+static const int ZIP_LOCAL_HEADER_BYTES = 30;
+static const long ZIP_MAX_COMMENT_BYTES = 0xFFFF;
+static const u16 ZIP_METHOD_STORED = 0;
+static const u16 ZIP_METHOD_DEFLATE = 8;
+
+/* zlib window bits (MAX_WBITS is 15) selecting the gzip wrapper and raw
+ * deflate data */
+static const int GZIP_WINDOW_BITS = 16 + 15;
+static const int RAW_DEFLATE_WINDOW_BITS = -15;
+
+/* Header bytes holding the global checksum, big endian */
+static const u32 GLOBAL_CHECKSUM_ADDR = 0x14E;
+
+typedef struct zip_entry {
+  u16 method;
+  u32 crc;
+  u32 compressed_size;
+  u32 size;
+  long data_offset;
+} zip_entry_t;
+
+static u16 get_u16(const u8 *buf_p) { return buf_p[0] | buf_p[1] << 8; }
+
+static u32 get_u32(const u8 *buf_p) {
+  return (u32)buf_p[0] | ((u32)buf_p[1] << 8) | ((u32)buf_p[2] << 16) |
+         ((u32)buf_p[3] << 24);
+}
+
+/**
+ * @brief Hash ROM data
+ * @param data_p Data
+ * @param len Number of bytes
+ * @return The FNV-1a 64-bit hash of the data
+ */
+u64 rom_hash(const u8 *data_p, size_t len) {
+  u64 hash = FNV64_OFFSET_BASIS;
+
+  for (size_t i = 0; i < len; i++) {
+    hash ^= data_p[i];
+    hash *= FNV64_PRIME;
+  }
+
+  return hash;
+}
+
+/**
+ * @brief Detect the container format from the first bytes of a file
+ * @param rom_path_p Path to the file
+ * @return The format, ROM_FORMAT_RAW for anything not recognized as an archive
+ */
+rom_format_t rom_file_format(const char *rom_path_p) {
+  u8 magic[6] = {0};
+  FILE *rom_file = fopen(rom_path_p, "rb");
+
+  if (rom_file == NULL) {
+    return ROM_FORMAT_RAW;
+  }
+
+  size_t read = fread(magic, 1, sizeof(magic), rom_file);
+  fclose(rom_file);
+
+  if (read >= sizeof(GZIP_MAGIC) &&
+      memcmp(magic, GZIP_MAGIC, sizeof(GZIP_MAGIC)) == 0) {
+    return ROM_FORMAT_GZIP;
+  }
+  if (read >= sizeof(ZIP_MAGIC) &&
+      memcmp(magic, ZIP_MAGIC, sizeof(ZIP_MAGIC)) == 0) {
+    return ROM_FORMAT_ZIP;
+  }
+  if (read >= sizeof(SEVEN_ZIP_MAGIC) &&
+      memcmp(magic, SEVEN_ZIP_MAGIC, sizeof(SEVEN_ZIP_MAGIC)) == 0) {
+    return ROM_FORMAT_7Z;
+  }
+
+  return ROM_FORMAT_RAW;
+}
+
+static bool has_rom_extension(const char *name_p, size_t len) {
+  const char *EXTENSIONS[] = {".gb", ".gbc", ".sgb"};
+
+  for (size_t i = 0; i < sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]); i++) {
+    size_t ext_len = strlen(EXTENSIONS[i]);
+
+    if (len >= ext_len) {
+      bool match = true;
+      for (size_t j = 0; j < ext_len; j++) {
+        char c = name_p[len - ext_len + j];
+        if (c >= 'A' && c <= 'Z') {
+          c += 'a' - 'A';
+        }
+        match &= c == EXTENSIONS[i][j];
+      }
+      if (match) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+/**
+ * @brief Find the ROM inside a zip archive
+ * @param rom_file Archive
+ * @param entry_p Filled with the entry's location and sizes
+ * @return true if a usable entry was found, false otherwise
+ *
+ * Sizes are taken from the central directory since the local headers may
+ * defer them to a data descriptor. The first .gb/.gbc/.sgb file wins, or the
+ * first file if there is none. Every length read from the archive is checked
+ * against the data it describes, so truncated or crafted archives are
+ * rejected rather than read out of bounds.
+ */
+static bool zip_find_rom(FILE *rom_file, zip_entry_t *entry_p) {
+  fseek(rom_file, 0, SEEK_END);
+  long file_size = ftell(rom_file);
+  long tail_size = ZIP_END_OF_CENTRAL_DIR_BYTES + ZIP_MAX_COMMENT_BYTES;
+  if (tail_size > file_size) {
+    tail_size = file_size;
+  }
+
+  u8 *tail_p = malloc(tail_size);
+  fseek(rom_file, file_size - tail_size, SEEK_SET);
+  if (tail_p == NULL ||
+      fread(tail_p, 1, tail_size, rom_file) != (size_t)tail_size) {
+    free(tail_p);
+    return false;
+  }
+
+  long eocd = tail_size - ZIP_END_OF_CENTRAL_DIR_BYTES;
+  while (eocd >= 0 && get_u32(tail_p + eocd) != ZIP_END_OF_CENTRAL_DIR_SIG) {
+    eocd--;
+  }
+  if (eocd < 0) {
+    free(tail_p);
+    return false;
+  }
+
+  u16 entries = get_u16(tail_p + eocd + 10);
+  u32 dir_size = get_u32(tail_p + eocd + 12);
+  u32 dir_offset = get_u32(tail_p + eocd + 16);
+  free(tail_p);
+
+  if ((long)dir_offset > file_size || dir_size > file_size - dir_offset) {
+    return false;
+  }
+
+  u8 *dir_p = malloc(dir_size);
+  fseek(rom_file, dir_offset, SEEK_SET);
+  if (dir_p == NULL || fread(dir_p, 1, dir_size, rom_file) != dir_size) {
+    free(dir_p);
+    return false;
+  }
+
+  bool found = false;
+  u32 pos = 0;
+  for (u16 i = 0; i < entries; i++) {
+    if (pos + ZIP_CENTRAL_DIR_ENTRY_BYTES > dir_size ||
+        get_u32(dir_p + pos) != ZIP_CENTRAL_DIR_SIG) {
+      break;
+    }
+
+    u8 *header_p = dir_p + pos;
+    u16 name_len = get_u16(header_p + 28);
+    u32 entry_size = ZIP_CENTRAL_DIR_ENTRY_BYTES + name_len +
+                     get_u16(header_p + 30) + get_u16(header_p + 32);
+    if (entry_size > dir_size - pos) {
+      break;
+    }
+
+    const char *name_p = (const char *)header_p + ZIP_CENTRAL_DIR_ENTRY_BYTES;
+    bool is_dir = name_len > 0 && name_p[name_len - 1] == '/';
+    bool is_rom = has_rom_extension(name_p, name_len);
+
+    if (!is_dir && (is_rom || !found)) {
+      entry_p->method = get_u16(header_p + 10);
+      entry_p->crc = get_u32(header_p + 16);
+      entry_p->compressed_size = get_u32(header_p + 20);
+      entry_p->size = get_u32(header_p + 24);
+      entry_p->data_offset = get_u32(header_p + 42);
+      found = true;
+
+      if (is_rom) {
+        break;
+      }
+    }
+
+    pos += entry_size;
+  }
+  free(dir_p);
+
+  if (!found) {
+    return false;
+  }
+
+  /* Skip the local header, its name and extra field can differ from the
+   * central directory's */
+  u8 local[ZIP_LOCAL_HEADER_BYTES];
+  if (entry_p->data_offset > file_size - ZIP_LOCAL_HEADER_BYTES) {
+    return false;
+  }
+  fseek(rom_file, entry_p->data_offset, SEEK_SET);
+  if (fread(local, sizeof(local), 1, rom_file) != 1) {
+    return false;
+  }
+  entry_p->data_offset +=
+      ZIP_LOCAL_HEADER_BYTES + get_u16(local + 26) + get_u16(local + 28);
+
+  return entry_p->data_offset <= file_size &&
+         entry_p->compressed_size <= file_size - entry_p->data_offset;
+}
+
+/**
+ * @brief Inflate a compressed stream into a buffer, a chunk at a time
+ * @param rom_file File positioned at the start of the stream
+ * @param window_bits zlib window bits, selecting the stream wrapper
+ * @param buf_p Destination
+ * @param size Expected decompressed size
+ * @return true if exactly `size` bytes were decompressed, false otherwise
+ */
+static bool inflate_into(FILE *rom_file, int window_bits, u8 *buf_p,
+                         u32 size) {
+#ifdef GBEMU_NO_ZLIB
+  return false;
+#else
+  u8 chunk[CHUNK_BYTES];
+  z_stream stream = {0};
+  int result = Z_OK;
+
+  if (inflateInit2(&stream, window_bits) != Z_OK) {
+    return false;
+  }
+
+  stream.next_out = buf_p;
+  stream.avail_out = size;
+
+  while (result != Z_STREAM_END) {
+    if (stream.avail_in == 0) {
+      stream.avail_in = fread(chunk, 1, sizeof(chunk), rom_file);
+      stream.next_in = chunk;
+      if (stream.avail_in == 0) {
+        break;
+      }
+    }
+
+    result = inflate(&stream, Z_NO_FLUSH);
+    if (result != Z_OK && result != Z_STREAM_END) {
+      break;
+    }
+    /* Larger than announced */
+    if (stream.avail_out == 0 && result != Z_STREAM_END) {
+      break;
+    }
+  }
+
+  bool ok = result == Z_STREAM_END && stream.total_out == size;
+  inflateEnd(&stream);
+
+  return ok;
+#endif
+}
+
+/**
+ * @brief Check data against the CRC-32 recorded in a zip entry
+ * @param entry_p Entry
+ * @param buf_p Data read for the entry
+ * @return true if the CRC matches
+ *
+ * The gzip trailer's CRC is already checked by inflate().
+ */
+static bool zip_crc_matches(const zip_entry_t *entry_p, const u8 *buf_p) {
+#ifdef GBEMU_NO_ZLIB
+  return false;
+#else
+  return crc32(crc32(0, NULL, 0), buf_p, entry_p->size) == entry_p->crc;
+#endif
+}
+
+/**
+ * @brief Size of a ROM without going through the cache
+ * @param rom_path_p Path to the ROM or archive
+ * @param format Container format
+ * @param size_p Set to the decompressed size
+ * @return true if successful, false otherwise
+ */
+static bool uncached_size(const char *rom_path_p, rom_format_t format,
+                          u32 *size_p) {
+  FILE *rom_file = fopen(rom_path_p, "rb");
+  bool ok = false;
+
+  if (rom_file == NULL) {
+    return false;
+  }
+
+  if (format == ROM_FORMAT_RAW) {
+    fseek(rom_file, 0, SEEK_END);
+    *size_p = ftell(rom_file);
+    ok = true;
+  } else if (format == ROM_FORMAT_GZIP) {
+    /* ISIZE, the last 4 bytes, is the decompressed size mod 2^32 */
+    u8 isize[4];
+    fseek(rom_file, -4, SEEK_END);
+    ok = fread(isize, sizeof(isize), 1, rom_file) == 1;
+    *size_p = get_u32(isize);
+  } else if (format == ROM_FORMAT_ZIP) {
+    zip_entry_t entry;
+    ok = zip_find_rom(rom_file, &entry);
+    if (ok) {
+      *size_p = entry.size;
+    }
+  }
+
+  fclose(rom_file);
+  return ok;
+}
+
+/**
+ * @brief Read a ROM without going through the cache
+ * @param rom_path_p Path to the ROM or archive
+ * @param format Container format
+ * @param buf_p Destination
+ * @param size Size returned by uncached_size()
+ * @return true if successful, false otherwise
+ */
+static bool uncached_read(const char *rom_path_p, rom_format_t format,
+                          u8 *buf_p, u32 size) {
+  FILE *rom_file = fopen(rom_path_p, "rb");
+  bool ok = false;
+
+  if (rom_file == NULL) {
+    return false;
+  }
+
+  if (format == ROM_FORMAT_RAW) {
+    ok = fread(buf_p, 1, size, rom_file) == size;
+  } else if (format == ROM_FORMAT_GZIP) {
+    ok = inflate_into(rom_file, GZIP_WINDOW_BITS, buf_p, size);
+  } else if (format == ROM_FORMAT_ZIP) {
+    zip_entry_t entry;
+
+    if (zip_find_rom(rom_file, &entry) && entry.size == size) {
+      fseek(rom_file, entry.data_offset, SEEK_SET);
+
+      if (entry.method == ZIP_METHOD_STORED) {
+        ok = fread(buf_p, 1, size, rom_file) == size;
+      } else if (entry.method == ZIP_METHOD_DEFLATE) {
+        ok = inflate_into(rom_file, RAW_DEFLATE_WINDOW_BITS, buf_p, size);
+      } else {
+        printf("Unsupported zip compression method %d\n", entry.method);
+      }
+
+      if (ok && !zip_crc_matches(&entry, buf_p)) {
+        printf("CRC mismatch in %s\n", rom_path_p);
+        ok = false;
+      }
+    }
+  }
+
+  fclose(rom_file);
+  return ok;
+}
+
+static const char *cache_dir(void) {
+  const char *dir_p = getenv(ROM_CACHE_ENV);
+
+  return dir_p && *dir_p ? dir_p : NULL;
+}
+
+/**
+ * @brief Absolute, canonical form of a path
+ * @param path_p Path
+ * @return A malloc'd path to free, or NULL if it cannot be resolved
+ */
+static char *canonical_path(const char *path_p) {
+#ifdef _WIN32
+  return _fullpath(NULL, path_p, 0);
+#else
+  return realpath(path_p, NULL);
+#endif
+}
+
+/**
+ * @brief Path of the index entry mapping an archive to its cached image
+ * @param buf_p Buffer to store the path
+ * @param buflen Length of the buffer
+ * @param rom_path_p Path to the archive
+ * @return false if the archive cannot be identified
+ *
+ * Archives are identified by canonical path, size and modification time, so
+ * the same archive reached through different relative paths shares an entry,
+ * and replacing it with a new file invalidates its entry.
+ */
+static bool cache_index_path(char *buf_p, size_t buflen,
+                             const char *rom_path_p) {
+  struct stat rom_stat;
+  char identity[CACHE_PATH_BYTES];
+  char *full_path_p = canonical_path(rom_path_p);
+
+  if (full_path_p == NULL || stat(full_path_p, &rom_stat) != 0) {
+    free(full_path_p);
+    return false;
+  }
+
+  int len = snprintf(identity, sizeof(identity), "%s|%lld|%lld", full_path_p,
+                     (long long)rom_stat.st_size, (long long)rom_stat.st_mtime);
+  free(full_path_p);
+  if (len < 0 || len >= (int)sizeof(identity)) {
+    return false;
+  }
+
+  snprintf(buf_p, buflen, "%s/%016llx.idx", cache_dir(),
+           (unsigned long long)rom_hash((const u8 *)identity, len));
+
+  return true;
+}
+
+/**
+ * @brief Find the cached image of an archive
+ * @param rom_path_p Path to the archive
+ * @param image_path_p Set to the path of the cached image
+ * @param buflen Length of image_path_p
+ * @param hash_p Set to the hash the image must have
+ * @param size_p Set to the size the image must have
+ * @return true on a cache hit, false otherwise
+ *
+ * An image whose size does not match the index is a miss, so the size
+ * returned for a hit is always the archive's decompressed size.
+ */
+static bool cache_lookup(const char *rom_path_p, char *image_path_p,
+                         size_t buflen, u64 *hash_p, u32 *size_p) {
+  char index_path[CACHE_PATH_BYTES];
+  char index[128] = {0};
+  unsigned int global_checksum, size;
+  unsigned long long hash;
+
+  if (!cache_dir() ||
+      !cache_index_path(index_path, sizeof(index_path), rom_path_p)) {
+    return false;
+  }
+
+  FILE *index_file = fopen(index_path, "r");
+  if (index_file == NULL) {
+    return false;
+  }
+  bool ok = fgets(index, sizeof(index), index_file) != NULL;
+  fclose(index_file);
+
+  if (!ok || sscanf(index, "%4x-%16llx.gb %u", &global_checksum, &hash,
+                    &size) != 3) {
+    return false;
+  }
+
+  snprintf(image_path_p, buflen, "%s/%04x-%016llx.gb", cache_dir(),
+           global_checksum, hash);
+  *hash_p = hash;
+  *size_p = size;
+
+  struct stat image_stat;
+  return stat(image_path_p, &image_stat) == 0 && image_stat.st_size == size;
+}
+
+/**
+ * @brief Create a uniquely named temporary file next to a path
+ * @param tmp_path_p Buffer set to the name of the file
+ * @param buflen Length of the buffer
+ * @param path_p Final path of the file
+ * @return The file opened for binary writing, or NULL on failure
+ */
+static FILE *create_temp(char *tmp_path_p, size_t buflen, const char *path_p) {
+  snprintf(tmp_path_p, buflen, "%s.XXXXXX", path_p);
+
+#ifdef _WIN32
+  if (_mktemp_s(tmp_path_p, strlen(tmp_path_p) + 1) != 0) {
+    return NULL;
+  }
+  return fopen(tmp_path_p, "wbx");
+#else
+  int fd = mkstemp(tmp_path_p);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  /* mkstemp() creates the file private, the cache is not */
+  fchmod(fd, 0644);
+  FILE *tmp_file = fdopen(fd, "wb");
+  if (tmp_file == NULL) {
+    close(fd);
+    remove(tmp_path_p);
+  }
+  return tmp_file;
+#endif
+}
+
+/**
+ * @brief Write a file atomically, so concurrent runs never see it half written
+ * @param path_p Destination path
+ * @param data_p Contents
+ * @param len Number of bytes
+ */
+static void write_atomically(const char *path_p, const void *data_p,
+                             size_t len) {
+  char tmp_path[CACHE_PATH_BYTES];
+  FILE *tmp_file = create_temp(tmp_path, sizeof(tmp_path), path_p);
+
+  if (tmp_file == NULL) {
+    return;
+  }
+
+  bool ok = fwrite(data_p, 1, len, tmp_file) == len;
+  ok &= fclose(tmp_file) == 0;
+
+  if (!ok || rename(tmp_path, path_p) != 0) {
+    remove(tmp_path);
+  }
+}
+
+/**
+ * @brief Store a decompressed image and map the archive to it
+ * @param rom_path_p Path to the archive
+ * @param buf_p Decompressed image
+ * @param size Size of the image
+ *
+ * Failing to write the cache is not an error, the next run decompresses again.
+ */
+static void cache_store(const char *rom_path_p, const u8 *buf_p, u32 size) {
+  char index_path[CACHE_PATH_BYTES];
+  char image_name[64];
+  char index[128];
+  char image_path[CACHE_PATH_BYTES];
+  u16 global_checksum = 0;
+
+  if (!cache_dir() ||
+      !cache_index_path(index_path, sizeof(index_path), rom_path_p)) {
+    return;
+  }
+
+  if (size > GLOBAL_CHECKSUM_ADDR + 1) {
+    global_checksum =
+        buf_p[GLOBAL_CHECKSUM_ADDR] << 8 | buf_p[GLOBAL_CHECKSUM_ADDR + 1];
+  }
+
+  mkdir(cache_dir(), 0755);
+  snprintf(image_name, sizeof(image_name), "%04x-%016llx.gb", global_checksum,
+           (unsigned long long)rom_hash(buf_p, size));
+  snprintf(image_path, sizeof(image_path), "%s/%s", cache_dir(), image_name);
+
+  /* Identical images from different archives share one file */
+  struct stat image_stat;
+  if (stat(image_path, &image_stat) != 0 || image_stat.st_size != size) {
+    write_atomically(image_path, buf_p, size);
+  }
+
+  int len = snprintf(index, sizeof(index), "%s %u\n", image_name, size);
+  write_atomically(index_path, index, len);
+}
+
+/**
+ * @brief Get the size of a ROM image
+ * @param rom_path_p Path to a raw ROM, or a .gz/.zip archive holding one
+ * @param size_p Set to the decompressed size
+ * @return true if successful, false otherwise or if larger than
+ * ROM_MAX_SIZE_BYTES
+ */
+bool rom_file_size(const char *rom_path_p, u32 *size_p) {
+  rom_format_t format = rom_file_format(rom_path_p);
+  char image_path[CACHE_PATH_BYTES];
+  u64 hash;
+
+  if (format == ROM_FORMAT_7Z) {
+    printf("7z archives are not supported: %s\n", rom_path_p);
+    return false;
+  }
+
+#ifdef GBEMU_NO_ZLIB
+  if (format != ROM_FORMAT_RAW) {
+    printf("Built without zlib, archives are not supported: %s\n", rom_path_p);
+    return false;
+  }
+#endif
+
+  bool ok;
+  if (format != ROM_FORMAT_RAW &&
+      cache_lookup(rom_path_p, image_path, sizeof(image_path), &hash,
+                   size_p)) {
+    ok = true;
+  } else {
+    ok = uncached_size(rom_path_p, format, size_p);
+  }
+
+  /* Also rejects directories, whose size reads back as garbage */
+  return ok && *size_p <= ROM_MAX_SIZE_BYTES;
+}
+
+/**
+ * @brief Read a ROM image into a buffer
+ * @param rom_path_p Path to a raw ROM, or a .gz/.zip archive holding one
+ * @param buf_p Destination
+ * @param size Size returned by rom_file_size()
+ * @return true if successful, false otherwise
+ *
+ * Archives are served from the cache when possible. Cached images are checked
+ * against their hash and decompressed again if they do not match; the
+ * cache's size always matches the archive's, so `size` stays valid.
+ */
+bool rom_file_read(const char *rom_path_p, u8 *buf_p, u32 size) {
+  rom_format_t format = rom_file_format(rom_path_p);
+  char image_path[CACHE_PATH_BYTES];
+  u64 hash;
+  u32 cached_size;
+
+  if (format == ROM_FORMAT_RAW) {
+    return uncached_read(rom_path_p, format, buf_p, size);
+  }
+
+  if (cache_lookup(rom_path_p, image_path, sizeof(image_path), &hash,
+                   &cached_size) &&
+      cached_size == size) {
+    if (uncached_read(image_path, ROM_FORMAT_RAW, buf_p, size) &&
+        rom_hash(buf_p, size) == hash) {
+      return true;
+    }
+    /* Corrupted, let it be stored again */
+    remove(image_path);
+  }
+
+  if (!uncached_read(rom_path_p, format, buf_p, size)) {
+    return false;
+  }
+
+  cache_store(rom_path_p, buf_p, size);
+  return true;
+}
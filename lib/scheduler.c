@@ -0,0 +1,110 @@
+/**
+ * @file scheduler.c
+ * @brief Timeline of upcoming hardware events, in CPU cycles
+ * @author Coaxial
+ * @date 2026-10-19
+ */
+
+#include "scheduler.h"
+
+/**
+ * @brief Start with nothing scheduled
+ * @param sched_p Scheduler
+ */
+void sched_init(sched_t *sched_p) {
+  for (int i = 0; i < SCHED_EVENT_COUNT; i++) {
+    sched_p->events[i] = (sched_event_t){.when = SCHED_NEVER};
+  }
+  sched_p->stop = false;
+}
+
+/**
+ * @brief Schedule an event, replacing any pending event of the same type
+ * @param sched_p Scheduler
+ * @param type Event type
+ * @param when Cycle the event is due at
+ * @param period Cycles between repeats, 0 for a one-shot event
+ * @param irq Interrupt flags raised when the event fires
+ */
+void sched_add(sched_t *sched_p, sched_event_type_t type, u64 when, u64 period,
+               u8 irq) {
+  sched_event_t *event_p = &sched_p->events[type];
+
+  event_p->when = when;
+  event_p->period = period;
+  event_p->irq = irq;
+}
+
+/**
+ * @brief Attach a handler to an event type, kept across sched_add() calls
+ * @param sched_p Scheduler
+ * @param type Event type
+ * @param handler_fn Function called when the event fires, or NULL
+ * @param user_p Passed to the handler
+ */
+void sched_set_handler(sched_t *sched_p, sched_event_type_t type,
+                       sched_handler_t handler_fn, void *user_p) {
+  sched_p->events[type].handler_fn = handler_fn;
+  sched_p->events[type].user_p = user_p;
+}
+
+/**
+ * @brief Unschedule an event
+ * @param sched_p Scheduler
+ * @param type Event type
+ */
+void sched_cancel(sched_t *sched_p, sched_event_type_t type) {
+  sched_p->events[type].when = SCHED_NEVER;
+}
+
+/**
+ * @brief Find the next event due
+ * @param sched_p Scheduler
+ * @param type_p Set to the type of the next event, may be NULL
+ * @return Cycle the next event is due at, or SCHED_NEVER
+ */
+u64 sched_next(const sched_t *sched_p, sched_event_type_t *type_p) {
+  u64 next = SCHED_NEVER;
+
+  for (int i = 0; i < SCHED_EVENT_COUNT; i++) {
+    if (sched_p->events[i].when < next) {
+      next = sched_p->events[i].when;
+      if (type_p) {
+        *type_p = i;
+      }
+    }
+  }
+
+  return next;
+}
+
+/**
+ * @brief Fire every event due at or before a cycle
+ * @param sched_p Scheduler
+ * @param now Current cycle
+ * @param if_p IF register, updated with the interrupts raised
+ * @return The interrupt flags raised
+ *
+ * Periodic events that fell behind fire once per missed period so their
+ * handlers observe every occurrence, in timeline order.
+ */
+u8 sched_fire_due(sched_t *sched_p, u64 now, u8 *if_p) {
+  u8 raised = 0;
+  sched_event_type_t type = SCHED_EVENT_COUNT;
+  u64 when;
+
+  /* Nothing is due at SCHED_NEVER, even when `now` is SCHED_NEVER */
+  while ((when = sched_next(sched_p, &type)) != SCHED_NEVER && when <= now) {
+    sched_event_t *event_p = &sched_p->events[type];
+
+    event_p->when = event_p->period ? when + event_p->period : SCHED_NEVER;
+    raised |= event_p->irq;
+
+    if (event_p->handler_fn) {
+      event_p->handler_fn(event_p->user_p, when);
+    }
+  }
+
+  *if_p |= raised;
+  return raised;
+}
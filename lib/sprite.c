@@ -0,0 +1,110 @@
+/**
+ * @file sprite.c
+ * @brief Per-scanline sprite selection
+ * @author Coaxial
+ * @date 2026-10-19
+ */
+
+#include "sprite.h"
+
+/* LCDC bit 2: 8x16 sprites */
+#define LCDC_OBJ_SIZE 2
+
+/* OAM Y coordinates are offset so that Y=16 is the top of the screen */
+static const int OAM_Y_OFFSET = 16;
+
+/**
+ * @brief Start with lists to be built on first use
+ * @param cache_p Sprite cache
+ */
+void sprite_cache_init(sprite_cache_t *cache_p) {
+  memset(cache_p, 0, sizeof(*cache_p));
+  cache_p->dirty = true;
+}
+
+/**
+ * @brief Mark the lists as stale, after OAM was changed behind the cache
+ * @param cache_p Sprite cache
+ */
+void sprite_cache_invalidate(sprite_cache_t *cache_p) { cache_p->dirty = true; }
+
+/**
+ * @brief Write to OAM through the cache
+ * @param cache_p Sprite cache
+ * @param mem_p Guest memory
+ * @param addr Address between OAM_START and OAM_START + OAM_SIZE
+ * @param value Value to write
+ */
+void sprite_oam_write(sprite_cache_t *cache_p, mem_t *mem_p, u16 addr,
+                      u8 value) {
+  u8 *byte_p = &mem_p->oam[addr - OAM_START];
+
+  if (*byte_p != value) {
+    *byte_p = value;
+    cache_p->dirty = true;
+  }
+}
+
+/**
+ * @brief Select up to 10 sprites per line and sort them by priority
+ * @param cache_p Sprite cache
+ * @param oam_p OAM
+ *
+ * The PPU picks the first 10 sprites in OAM order overlapping a line. On DMG
+ * the one with the smaller X is drawn on top, OAM order breaking ties.
+ */
+static void rebuild(sprite_cache_t *cache_p, const oam_entry_t *oam_p) {
+  memset(cache_p->counts, 0, sizeof(cache_p->counts));
+
+  for (int i = 0; i < OAM_ENTRIES; i++) {
+    int top = oam_p[i].y - OAM_Y_OFFSET;
+    int start = top < 0 ? 0 : top;
+    int end = top + cache_p->height;
+
+    for (int line = start; line < end && line < SCREEN_HEIGHT; line++) {
+      if (cache_p->counts[line] < SPRITES_PER_LINE) {
+        cache_p->lines[line][cache_p->counts[line]++] = i;
+      }
+    }
+  }
+
+  for (int line = 0; line < SCREEN_HEIGHT; line++) {
+    u8 *list_p = cache_p->lines[line];
+
+    /* Insertion sort: at most 10 entries, already in OAM order, and stable so
+     * ties stay in OAM order */
+    for (int i = 1; i < cache_p->counts[line]; i++) {
+      u8 index = list_p[i];
+      int j = i - 1;
+
+      while (j >= 0 && oam_p[list_p[j]].x > oam_p[index].x) {
+        list_p[j + 1] = list_p[j];
+        j--;
+      }
+      list_p[j + 1] = index;
+    }
+  }
+
+  cache_p->dirty = false;
+}
+
+/**
+ * @brief Get the sprites to draw on a line
+ * @param cache_p Sprite cache
+ * @param mem_p Guest memory, for OAM and LCDC
+ * @param ly Line, below SCREEN_HEIGHT
+ * @param count_p Set to the number of sprites on the line
+ * @return OAM indexes of the sprites, highest priority first
+ */
+const u8 *sprite_cache_line(sprite_cache_t *cache_p, const mem_t *mem_p,
+                            u8 ly, u8 *count_p) {
+  u8 height = BIT(mem_p->io[REG_LCDC], LCDC_OBJ_SIZE) ? 16 : 8;
+
+  if (cache_p->dirty || cache_p->height != height) {
+    cache_p->height = height;
+    rebuild(cache_p, (const oam_entry_t *)mem_p->oam);
+  }
+
+  *count_p = cache_p->counts[ly];
+  return cache_p->lines[ly];
+}
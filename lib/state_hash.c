@@ -0,0 +1,276 @@
+/**
+ * @file state_hash.c
+ * @brief Per-frame hashes of the emulator state, used to find the first frame
+ * where two builds of the core stop agreeing.
+ * @author Coaxial
+ * @date 2026-10-19
+ */
+
+#include "state_hash.h"
+
+/* FNV-1a, see http://www.isthe.com/chongo/tech/comp/fnv/ */
+static const u32 FNV_PRIME = 0x01000193;
+
+static const char *COMPONENT_NAMES[] = {
+    [STATE_HASH_CPU] = "CPU",
+    [STATE_HASH_RAM] = "RAM",
+    [STATE_HASH_FRAMEBUFFER] = "Framebuffer",
+};
+
+/**
+ * @brief Feed bytes into a running FNV-1a hash
+ * @param hash Hash so far, STATE_HASH_INIT to start a new one
+ * @param data_p Bytes to hash, may be NULL when len is 0
+ * @param len Number of bytes
+ * @return The updated hash
+ */
+u32 state_hash_bytes(u32 hash, const u8 *data_p, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    hash ^= data_p[i];
+    hash *= FNV_PRIME;
+  }
+
+  return hash;
+}
+
+/**
+ * @brief Hash the CPU registers, cycle count and halt/interrupt state
+ * @param cpu_p CPU context, or NULL
+ * @return The hash of the CPU state
+ *
+ * Fields are serialized one by one rather than hashing the struct so that
+ * padding and field order never change the result.
+ */
+u32 state_hash_cpu(const cpu_ctx_t *cpu_p) {
+  if (!cpu_p) {
+    return state_hash_bytes(STATE_HASH_INIT, NULL, 0);
+  }
+
+  const registers_t *regs_p = &cpu_p->regs;
+  u8 bytes[] = {
+      regs_p->a,         regs_p->f,      regs_p->b,         regs_p->c,
+      regs_p->d,         regs_p->e,      regs_p->h,         regs_p->l,
+      regs_p->pc & 0xFF, regs_p->pc >> 8, regs_p->sp & 0xFF, regs_p->sp >> 8,
+  };
+  u8 state[] = {cpu_p->ime, cpu_p->halted, cpu_p->stopped, cpu_p->halt_bug};
+  u8 cycles[8];
+  for (int i = 0; i < 8; i++) {
+    cycles[i] = (cpu_p->cycles >> (i * 8)) & 0xFF;
+  }
+
+  u32 hash = state_hash_bytes(STATE_HASH_INIT, bytes, sizeof(bytes));
+  hash = state_hash_bytes(hash, state, sizeof(state));
+  return state_hash_bytes(hash, cycles, sizeof(cycles));
+}
+
+/**
+ * @brief Hash every component of a snapshot into a record
+ * @param record_p Record to fill
+ * @param frame Frame number the snapshot was taken at
+ * @param snapshot_p State to hash
+ */
+void state_hash_frame(state_hash_record_t *record_p, u32 frame,
+                      const state_snapshot_t *snapshot_p) {
+  record_p->frame = frame;
+  record_p->hashes[STATE_HASH_CPU] = state_hash_cpu(snapshot_p->cpu_p);
+  record_p->hashes[STATE_HASH_RAM] =
+      state_hash_bytes(STATE_HASH_INIT, snapshot_p->ram_p,
+                       snapshot_p->ram_p ? snapshot_p->ram_len : 0);
+  record_p->hashes[STATE_HASH_FRAMEBUFFER] = state_hash_bytes(
+      STATE_HASH_INIT, snapshot_p->framebuffer_p,
+      snapshot_p->framebuffer_p ? snapshot_p->framebuffer_len : 0);
+}
+
+/**
+ * @brief Human readable name of a hashed component
+ * @param component Component code
+ * @return The component name
+ */
+const char *state_hash_component_name(state_hash_component_t component) {
+  if (component >= STATE_HASH_COMPONENT_COUNT) {
+    return "Length";
+  }
+
+  return COMPONENT_NAMES[component];
+}
+
+static void put_u32(u8 *buf_p, u32 value) {
+  buf_p[0] = value & 0xFF;
+  buf_p[1] = (value >> 8) & 0xFF;
+  buf_p[2] = (value >> 16) & 0xFF;
+  buf_p[3] = (value >> 24) & 0xFF;
+}
+
+static u32 get_u32(const u8 *buf_p) {
+  return (u32)buf_p[0] | ((u32)buf_p[1] << 8) | ((u32)buf_p[2] << 16) |
+         ((u32)buf_p[3] << 24);
+}
+
+/**
+ * @brief Write the log header
+ * @param file_p Log file opened for binary writing
+ * @return true if successful, false otherwise
+ */
+bool state_hash_write_header(FILE *file_p) {
+  u8 header[8];
+  memcpy(header, STATE_HASH_MAGIC, 4);
+  header[4] = STATE_HASH_VERSION & 0xFF;
+  header[5] = STATE_HASH_VERSION >> 8;
+  header[6] = STATE_HASH_COMPONENT_COUNT & 0xFF;
+  header[7] = STATE_HASH_COMPONENT_COUNT >> 8;
+
+  return fwrite(header, sizeof(header), 1, file_p) == 1;
+}
+
+/**
+ * @brief Read and validate the log header
+ * @param file_p Log file opened for binary reading
+ * @return true if the header matches this build's format, false otherwise
+ */
+bool state_hash_read_header(FILE *file_p) {
+  u8 header[8];
+
+  if (fread(header, sizeof(header), 1, file_p) != 1) {
+    return false;
+  }
+
+  return memcmp(header, STATE_HASH_MAGIC, 4) == 0 &&
+         (header[4] | header[5] << 8) == STATE_HASH_VERSION &&
+         (header[6] | header[7] << 8) == STATE_HASH_COMPONENT_COUNT;
+}
+
+/**
+ * @brief Append a record to a log
+ * @param file_p Log file opened for binary writing
+ * @param record_p Record to write
+ * @return true if successful, false otherwise
+ */
+bool state_hash_write_record(FILE *file_p,
+                             const state_hash_record_t *record_p) {
+  u8 buf[STATE_HASH_RECORD_BYTES];
+
+  put_u32(buf, record_p->frame);
+  for (int i = 0; i < STATE_HASH_COMPONENT_COUNT; i++) {
+    put_u32(buf + 4 * (i + 1), record_p->hashes[i]);
+  }
+
+  return fwrite(buf, sizeof(buf), 1, file_p) == 1;
+}
+
+/**
+ * @brief Read the next record from a log
+ * @param file_p Log file opened for binary reading, past the header
+ * @param record_p Record to fill
+ * @return true if a full record was read, false at the end of the log
+ */
+bool state_hash_read_record(FILE *file_p, state_hash_record_t *record_p) {
+  u8 buf[STATE_HASH_RECORD_BYTES];
+
+  if (fread(buf, sizeof(buf), 1, file_p) != 1) {
+    return false;
+  }
+
+  record_p->frame = get_u32(buf);
+  for (int i = 0; i < STATE_HASH_COMPONENT_COUNT; i++) {
+    record_p->hashes[i] = get_u32(buf + 4 * (i + 1));
+  }
+
+  return true;
+}
+
+/**
+ * @brief Open a log and write its header
+ * @param log_p Log to initialize
+ * @param path_p Path of the log file, truncated if it exists
+ * @return true if successful, false otherwise
+ */
+bool state_hash_log_open(state_hash_log_t *log_p, const char *path_p) {
+  log_p->frame = 0;
+  log_p->file_p = fopen(path_p, "wb");
+
+  if (log_p->file_p == NULL) {
+    printf("Error opening state hash log: %s\n", path_p);
+    return false;
+  }
+
+  if (!state_hash_write_header(log_p->file_p)) {
+    state_hash_log_close(log_p);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Hash the state at a frame boundary and append it to the log
+ * @param log_p Open log
+ * @param snapshot_p State to hash
+ * @return true if successful, false otherwise
+ */
+bool state_hash_log_frame(state_hash_log_t *log_p,
+                          const state_snapshot_t *snapshot_p) {
+  state_hash_record_t record;
+  state_hash_frame(&record, log_p->frame++, snapshot_p);
+
+  return state_hash_write_record(log_p->file_p, &record);
+}
+
+/**
+ * @brief Flush and close a log
+ * @param log_p Log to close, safe to call on a closed log
+ */
+void state_hash_log_close(state_hash_log_t *log_p) {
+  if (log_p->file_p) {
+    fclose(log_p->file_p);
+    log_p->file_p = NULL;
+  }
+}
+
+/**
+ * @brief Find the first frame where two logs disagree
+ * @param expected_p Reference log, opened for binary reading
+ * @param actual_p Log under test, opened for binary reading
+ * @param divergence_p Filled with the first mismatch when there is one
+ * @return Whether the logs are identical, diverge, differ in length, or could
+ * not be read
+ *
+ * Components are compared in state_hash_component_t order, so a CPU mismatch
+ * is reported ahead of the RAM or framebuffer mismatches it usually causes.
+ */
+state_hash_diff_result_t
+state_hash_diff(FILE *expected_p, FILE *actual_p,
+                state_hash_divergence_t *divergence_p) {
+  if (!state_hash_read_header(expected_p) ||
+      !state_hash_read_header(actual_p)) {
+    return STATE_HASH_DIFF_BAD_LOG;
+  }
+
+  state_hash_record_t expected, actual;
+
+  for (;;) {
+    bool has_expected = state_hash_read_record(expected_p, &expected);
+    bool has_actual = state_hash_read_record(actual_p, &actual);
+
+    if (!has_expected && !has_actual) {
+      return STATE_HASH_DIFF_IDENTICAL;
+    }
+
+    if (has_expected != has_actual) {
+      divergence_p->frame = has_expected ? expected.frame : actual.frame;
+      divergence_p->component = STATE_HASH_COMPONENT_COUNT;
+      divergence_p->expected = has_expected;
+      divergence_p->actual = has_actual;
+      return STATE_HASH_DIFF_LENGTH;
+    }
+
+    for (int i = 0; i < STATE_HASH_COMPONENT_COUNT; i++) {
+      if (expected.hashes[i] != actual.hashes[i]) {
+        divergence_p->frame = expected.frame;
+        divergence_p->component = i;
+        divergence_p->expected = expected.hashes[i];
+        divergence_p->actual = actual.hashes[i];
+        return STATE_HASH_DIFF_DIVERGED;
+      }
+    }
+  }
+}
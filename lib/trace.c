@@ -0,0 +1,251 @@
+/**
+ * @file trace.c
+ * @brief Binary CPU trace, written to disk by a background thread
+ * @author Coaxial
+ * @date 2026-10-19
+ */
+
+#include <sched.h>
+#include <time.h>
+
+#include "trace.h"
+
+/* Records encoded per fwrite() by the writer thread */
+#define WRITE_BATCH 512
+
+/* How long the writer sleeps when the ring is empty */
+static const long WRITER_IDLE_NS = 200000;
+
+/**
+ * @brief Serialize a record, little endian
+ * @param buf_p TRACE_RECORD_BYTES bytes to fill
+ * @param record_p Record
+ */
+void trace_encode_record(u8 *buf_p, const trace_record_t *record_p) {
+  for (int i = 0; i < 8; i++) {
+    buf_p[i] = (record_p->cycles >> (i * 8)) & 0xFF;
+  }
+  buf_p[8] = record_p->pc & 0xFF;
+  buf_p[9] = record_p->pc >> 8;
+  buf_p[10] = record_p->sp & 0xFF;
+  buf_p[11] = record_p->sp >> 8;
+  buf_p[12] = record_p->a;
+  buf_p[13] = record_p->f;
+  buf_p[14] = record_p->b;
+  buf_p[15] = record_p->c;
+  buf_p[16] = record_p->d;
+  buf_p[17] = record_p->e;
+  buf_p[18] = record_p->h;
+  buf_p[19] = record_p->l;
+  memcpy(buf_p + 20, record_p->pcmem, 4);
+}
+
+/**
+ * @brief Write out every record published so far
+ * @param trace_p Trace
+ * @return false if writing to the file failed
+ */
+static bool drain(trace_t *trace_p) {
+  u8 buf[WRITE_BATCH * TRACE_RECORD_BYTES];
+  u64 tail = atomic_load_explicit(&trace_p->tail, memory_order_relaxed);
+  u64 head = atomic_load_explicit(&trace_p->head, memory_order_acquire);
+
+  while (tail != head) {
+    size_t count = 0;
+
+    while (tail != head && count < WRITE_BATCH) {
+      trace_encode_record(buf + count * TRACE_RECORD_BYTES,
+                          &trace_p->ring_p[tail & trace_p->mask]);
+      tail++;
+      count++;
+    }
+
+    bool ok = fwrite(buf, TRACE_RECORD_BYTES, count, trace_p->file_p) == count;
+    /* Release the slots even on failure so the emulation never deadlocks */
+    atomic_store_explicit(&trace_p->tail, tail, memory_order_release);
+    if (!ok) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void *writer_main(void *user_p) {
+  trace_t *trace_p = user_p;
+  struct timespec idle = {.tv_nsec = WRITER_IDLE_NS};
+
+  for (;;) {
+    /* Read stop first: everything published before it was set is then
+     * visible to the drain below */
+    bool stop = atomic_load_explicit(&trace_p->stop, memory_order_acquire);
+    u64 tail = atomic_load_explicit(&trace_p->tail, memory_order_relaxed);
+
+    if (atomic_load_explicit(&trace_p->head, memory_order_acquire) == tail) {
+      if (stop) {
+        break;
+      }
+      nanosleep(&idle, NULL);
+      continue;
+    }
+
+    if (atomic_load_explicit(&trace_p->write_failed, memory_order_relaxed)) {
+      atomic_store_explicit(&trace_p->tail,
+                            atomic_load_explicit(&trace_p->head,
+                                                 memory_order_acquire),
+                            memory_order_release);
+    } else if (!drain(trace_p)) {
+      printf("Error writing trace, further records are discarded\n");
+      atomic_store_explicit(&trace_p->write_failed, true,
+                            memory_order_relaxed);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Create a trace file and start its writer thread
+ * @param trace_p Trace to initialize
+ * @param path_p Path of the trace file, truncated if it exists
+ * @param capacity_log2 Ring size as a power of two number of records, up to
+ * TRACE_MAX_CAPACITY_LOG2
+ * @return true if successful, false otherwise
+ */
+bool trace_open(trace_t *trace_p, const char *path_p, u8 capacity_log2) {
+  u8 header[6] = {TRACE_MAGIC[0],       TRACE_MAGIC[1],
+                  TRACE_MAGIC[2],       TRACE_MAGIC[3],
+                  TRACE_VERSION & 0xFF, TRACE_VERSION >> 8};
+
+  memset(trace_p, 0, sizeof(*trace_p));
+
+  if (capacity_log2 > TRACE_MAX_CAPACITY_LOG2) {
+    printf("Trace ring too large: 2^%d records\n", capacity_log2);
+    return false;
+  }
+
+  trace_p->mask = (1ULL << capacity_log2) - 1;
+  trace_p->file_p = fopen(path_p, "wb");
+
+  if (trace_p->file_p == NULL) {
+    printf("Error opening trace: %s\n", path_p);
+    return false;
+  }
+
+  trace_p->ring_p = malloc((trace_p->mask + 1) * sizeof(trace_record_t));
+
+  if (trace_p->ring_p == NULL ||
+      fwrite(header, sizeof(header), 1, trace_p->file_p) != 1 ||
+      pthread_create(&trace_p->writer, NULL, writer_main, trace_p) != 0) {
+    free(trace_p->ring_p);
+    fclose(trace_p->file_p);
+    trace_p->ring_p = NULL;
+    trace_p->file_p = NULL;
+    return false;
+  }
+
+  trace_p->writer_started = true;
+  return true;
+}
+
+/**
+ * @brief Flush the remaining records, stop the writer and close the file
+ * @param trace_p Trace, safe to call after trace_open() failed or twice
+ */
+void trace_close(trace_t *trace_p) {
+  if (!trace_p->writer_started) {
+    return;
+  }
+
+  atomic_store_explicit(&trace_p->stop, true, memory_order_release);
+  pthread_join(trace_p->writer, NULL);
+  trace_p->writer_started = false;
+
+  fclose(trace_p->file_p);
+  free(trace_p->ring_p);
+  trace_p->file_p = NULL;
+  trace_p->ring_p = NULL;
+}
+
+/**
+ * @brief Block the emulation thread until the writer frees a slot
+ * @param trace_p Trace with a full ring
+ *
+ * Out of line since it only runs when the writer falls behind.
+ */
+void trace_wait_for_space(trace_t *trace_p) {
+  u64 head = atomic_load_explicit(&trace_p->head, memory_order_relaxed);
+
+  trace_p->stalls++;
+  while (head - atomic_load_explicit(&trace_p->tail, memory_order_acquire) >
+         trace_p->mask) {
+    sched_yield();
+  }
+}
+
+/**
+ * @brief Read and validate the trace header
+ * @param file_p Trace file opened for binary reading
+ * @return true if the header matches this build's format, false otherwise
+ */
+bool trace_read_header(FILE *file_p) {
+  u8 header[6];
+
+  if (fread(header, sizeof(header), 1, file_p) != 1) {
+    return false;
+  }
+
+  return memcmp(header, TRACE_MAGIC, 4) == 0 &&
+         (header[4] | header[5] << 8) == TRACE_VERSION;
+}
+
+/**
+ * @brief Read the next record from a trace
+ * @param file_p Trace file opened for binary reading, past the header
+ * @param record_p Record to fill
+ * @return true if a full record was read, false at the end of the trace
+ */
+bool trace_read_record(FILE *file_p, trace_record_t *record_p) {
+  u8 buf[TRACE_RECORD_BYTES];
+
+  if (fread(buf, sizeof(buf), 1, file_p) != 1) {
+    return false;
+  }
+
+  record_p->cycles = 0;
+  for (int i = 0; i < 8; i++) {
+    record_p->cycles |= (u64)buf[i] << (i * 8);
+  }
+  record_p->pc = buf[8] | buf[9] << 8;
+  record_p->sp = buf[10] | buf[11] << 8;
+  record_p->a = buf[12];
+  record_p->f = buf[13];
+  record_p->b = buf[14];
+  record_p->c = buf[15];
+  record_p->d = buf[16];
+  record_p->e = buf[17];
+  record_p->h = buf[18];
+  record_p->l = buf[19];
+  memcpy(record_p->pcmem, buf + 20, 4);
+
+  return true;
+}
+
+/**
+ * @brief Format a record as a gameboy-doctor log line
+ * @param buf_p Buffer to store the line, without a trailing newline
+ * @param buflen Length of the buffer
+ * @param record_p Record
+ *
+ * See https://github.com/robert/gameboy-doctor#formatting-your-log-file
+ */
+void trace_format_doctor(char *buf_p, size_t buflen,
+                         const trace_record_t *record_p) {
+  snprintf(buf_p, buflen,
+           "A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X "
+           "SP:%04X PC:%04X PCMEM:%02X,%02X,%02X,%02X",
+           record_p->a, record_p->f, record_p->b, record_p->c, record_p->d,
+           record_p->e, record_p->h, record_p->l, record_p->sp, record_p->pc,
+           record_p->pcmem[0], record_p->pcmem[1], record_p->pcmem[2],
+           record_p->pcmem[3]);
+}
@@ -1,8 +1,25 @@
 #include <check.h>
+#include <dirent.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utime.h>
+#include <zlib.h>
 
+#include "boot.h"
 #include "cart.h"
 #include "cpu.h"
+#include "dma.h"
+#include "emu.h"
+#include "idle.h"
+#include "link.h"
+#include "rom_file.h"
+#include "scheduler.h"
+#include "sprite.h"
+#include "state_hash.h"
+#include "trace.h"
 
 /**
  * Cart Test Suite
@@ -10,17 +27,22 @@
 START_TEST(test_cart_metadata) {
   cart_t cart = load_cart("../roms/tests/blargg/cpu_instrs.gb");
 
-  ck_assert_str_eq(cart.metadata->title, "CPU_INSTRS");
-  ck_assert_uint_eq(cart.metadata->new_licensee_code, 0x00);
-  ck_assert_uint_eq(cart.metadata->sgb_flag, 0x00);
-  ck_assert_uint_eq(cart.metadata->cart_type, 0x01);
-  ck_assert_uint_eq(cart.metadata->rom_size_code, 0x01);
-  ck_assert_uint_eq(cart.metadata->ram_size_code, 0x00);
-  ck_assert_uint_eq(cart.metadata->destination_code, 0x00);
-  ck_assert_uint_eq(cart.metadata->old_licensee_code, 0x00);
-  ck_assert_uint_eq(cart.metadata->version, 0x00);
-  ck_assert_uint_eq(cart.metadata->checksum, 0x3b);
-  ck_assert_uint_eq(cart.metadata->global_checksum, 0xf530);
+  ck_assert_str_eq(cart.metadata.title, "CPU_INSTRS");
+  ck_assert_uint_eq(cart.metadata.new_licensee_code, 0x00);
+  ck_assert_uint_eq(cart.metadata.sgb_flag, 0x00);
+  ck_assert_uint_eq(cart.metadata.cart_type, 0x01);
+  ck_assert_uint_eq(cart.metadata.rom_size_code, 0x01);
+  ck_assert_uint_eq(cart.metadata.ram_size_code, 0x00);
+  ck_assert_uint_eq(cart.metadata.destination_code, 0x00);
+  ck_assert_uint_eq(cart.metadata.old_licensee_code, 0x00);
+  ck_assert_uint_eq(cart.metadata.version, 0x00);
+  ck_assert_uint_eq(cart.metadata.checksum, 0x3b);
+  ck_assert_uint_eq(cart.metadata.global_checksum, 0xf530);
+
+  unload_cart(&cart);
+
+  /* Nothing left to print */
+  print_cart_metadata();
 }
 END_TEST
 
@@ -52,9 +74,22 @@ START_TEST(test_get_licensee_name) {
 END_TEST
 
 START_TEST(test_metadata_title_padding) {
-  cart_t cart = load_cart("../roms/tests/new_lic_code.gb");
+  const char *PATH = "../roms/tests/new_lic_code.gb";
+  cart_t cart = load_cart((char *)PATH);
+  u8 header[0x50];
+
+  ck_assert_str_eq(cart.metadata.title, "COFFEEBREAK");
 
-  ck_assert_str_eq(cart.metadata->title, "COFFEEBREAK");
+  /* The title padding and byte-swapped fields only live in the copy: the
+   * guest still reads the header as stored */
+  FILE *file_p = fopen(PATH, "rb");
+  ck_assert(file_p != NULL);
+  ck_assert_int_eq(fseek(file_p, 0x100, SEEK_SET), 0);
+  ck_assert_uint_eq(fread(header, 1, sizeof(header), file_p), sizeof(header));
+  fclose(file_p);
+  ck_assert_mem_eq(cart.rom_p + 0x100, header, sizeof(header));
+
+  unload_cart(&cart);
 }
 END_TEST
 
@@ -88,6 +123,209 @@ START_TEST(test_get_ram_size) {
 
     ck_assert_int_eq(actual, expected);
   }
+
+  cart_metadata_t metadata = {.ram_size_code = 0x03};
+  ck_assert_uint_eq(cart_ram_size_bytes(&metadata), 32 * 1024);
+  metadata.ram_size_code = 0x01;
+  ck_assert_uint_eq(cart_ram_size_bytes(&metadata), 0);
+  metadata.ram_size_code = 0x42;
+  ck_assert_uint_eq(cart_ram_size_bytes(&metadata), 0);
+}
+END_TEST
+
+START_TEST(test_load_compressed_cart) {
+  const char *ARCHIVES[] = {"../roms/tests/archives/cpu_instrs.gb.gz",
+                            "../roms/tests/archives/cpu_instrs.zip"};
+  cart_t raw = load_cart("../roms/tests/blargg/cpu_instrs.gb");
+
+  for (size_t i = 0; i < sizeof(ARCHIVES) / sizeof(ARCHIVES[0]); i++) {
+    cart_t cart = load_cart((char *)ARCHIVES[i]);
+
+    ck_assert_uint_eq(cart.rom_size_bytes, raw.rom_size_bytes);
+    ck_assert_mem_eq(cart.rom_p, raw.rom_p, raw.rom_size_bytes);
+    ck_assert_str_eq(cart.metadata.title, "CPU_INSTRS");
+    unload_cart(&cart);
+  }
+
+  unload_cart(&raw);
+}
+END_TEST
+
+START_TEST(test_rom_file_format) {
+  const char *path_p = "check_gbe_rom.7z";
+  const u8 SEVEN_ZIP[] = {'7', 'z', 0xBC, 0xAF, 0x27, 0x1C, 0x00, 0x04};
+  FILE *file_p = fopen(path_p, "wb");
+  fwrite(SEVEN_ZIP, sizeof(SEVEN_ZIP), 1, file_p);
+  fclose(file_p);
+  u32 size;
+
+  ck_assert_int_eq(rom_file_format("../roms/tests/blargg/cpu_instrs.gb"),
+                   ROM_FORMAT_RAW);
+  ck_assert_int_eq(rom_file_format("../roms/tests/archives/cpu_instrs.gb.gz"),
+                   ROM_FORMAT_GZIP);
+  ck_assert_int_eq(rom_file_format("../roms/tests/archives/cpu_instrs.zip"),
+                   ROM_FORMAT_ZIP);
+  ck_assert_int_eq(rom_file_format(path_p), ROM_FORMAT_7Z);
+  ck_assert(!rom_file_size(path_p, &size));
+
+  remove(path_p);
+}
+END_TEST
+
+static void put_le(u8 *buf_p, u32 value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    buf_p[i] = (value >> (i * 8)) & 0xFF;
+  }
+}
+
+/* Writes a zip archive storing `data_p` uncompressed as "a.gb", with the
+ * central directory's CRC, name length and compressed size as given */
+static void write_stored_zip(const char *path_p, const u8 *data_p, u32 size,
+                             u32 crc, u16 name_len, u32 compressed_size) {
+  u8 local[30 + 4] = {'P', 'K', 0x03, 0x04};
+  u8 central[46 + 4] = {'P', 'K', 0x01, 0x02};
+  u8 end[22] = {'P', 'K', 0x05, 0x06};
+
+  put_le(local + 14, crc, 4);
+  put_le(local + 18, size, 4);
+  put_le(local + 22, size, 4);
+  put_le(local + 26, 4, 2);
+  memcpy(local + 30, "a.gb", 4);
+
+  put_le(central + 16, crc, 4);
+  put_le(central + 20, compressed_size, 4);
+  put_le(central + 24, size, 4);
+  put_le(central + 28, name_len, 2);
+  memcpy(central + 46, "a.gb", 4);
+
+  put_le(end + 10, 1, 2);
+  put_le(end + 12, sizeof(central), 4);
+  put_le(end + 16, sizeof(local) + size, 4);
+
+  FILE *file_p = fopen(path_p, "wb");
+  fwrite(local, sizeof(local), 1, file_p);
+  fwrite(data_p, size, 1, file_p);
+  fwrite(central, sizeof(central), 1, file_p);
+  fwrite(end, sizeof(end), 1, file_p);
+  fclose(file_p);
+}
+
+START_TEST(test_rom_zip_malformed) {
+  const char *path_p = "check_gbe_malformed.zip";
+  static u8 data[0x200], read[0x200];
+  u32 crc, size;
+
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = i * 7;
+  }
+  crc = crc32(crc32(0, NULL, 0), data, sizeof(data));
+
+  write_stored_zip(path_p, data, sizeof(data), crc, 4, sizeof(data));
+  ck_assert(rom_file_size(path_p, &size));
+  ck_assert_uint_eq(size, sizeof(data));
+  ck_assert(rom_file_read(path_p, read, size));
+  ck_assert_mem_eq(read, data, size);
+
+  /* Data that does not match its CRC */
+  write_stored_zip(path_p, data, sizeof(data), crc ^ 1, 4, sizeof(data));
+  ck_assert(rom_file_size(path_p, &size));
+  ck_assert(!rom_file_read(path_p, read, size));
+
+  /* Name running past the central directory */
+  write_stored_zip(path_p, data, sizeof(data), crc, 0x4000, sizeof(data));
+  ck_assert(!rom_file_size(path_p, &size));
+
+  /* Compressed data running past the end of the file */
+  write_stored_zip(path_p, data, sizeof(data), crc, 4, 0x10000000);
+  ck_assert(!rom_file_size(path_p, &size));
+
+  remove(path_p);
+}
+END_TEST
+
+static void write_file(const char *path_p, const u8 *data_p, size_t len) {
+  FILE *file_p = fopen(path_p, "wb");
+  fwrite(data_p, 1, len, file_p);
+  fclose(file_p);
+}
+
+START_TEST(test_rom_cache) {
+  const char *archive_p = "check_gbe_rom.zip";
+  const char *cache_p = "check_gbe_rom_cache";
+  static u8 archive[0x10000], garbage[0x10000];
+  static u8 first[0x10000], second[0x10000];
+  char image_path[512];
+  struct stat archive_stat, image_stat;
+  u32 size;
+
+  /* Work on a copy so its contents can be changed behind the cache */
+  FILE *file_p = fopen("../roms/tests/archives/cpu_instrs.zip", "rb");
+  size_t archive_len = fread(archive, 1, sizeof(archive), file_p);
+  fclose(file_p);
+  write_file(archive_p, archive, archive_len);
+  stat(archive_p, &archive_stat);
+  struct utimbuf times = {archive_stat.st_atime, archive_stat.st_mtime};
+
+  setenv(ROM_CACHE_ENV, cache_p, 1);
+
+  ck_assert(rom_file_size(archive_p, &size));
+  ck_assert_uint_eq(size, sizeof(first));
+  ck_assert(rom_file_read(archive_p, first, size));
+
+  /* Stored under the global checksum and the hash of the image */
+  snprintf(image_path, sizeof(image_path), "%s/f530-%016llx.gb", cache_p,
+           (unsigned long long)rom_hash(first, size));
+  ck_assert_int_eq(stat(image_path, &image_stat), 0);
+  ck_assert_int_eq(image_stat.st_size, size);
+
+  /* Garble all but the magic of the archive without changing its size or
+   * mtime: it can now only be served from the cache, also through another
+   * relative path */
+  memset(garbage, 0xA5, archive_len);
+  memcpy(garbage, archive, 4);
+  write_file(archive_p, garbage, archive_len);
+  utime(archive_p, &times);
+  ck_assert(rom_file_size("./check_gbe_rom.zip", &size));
+  ck_assert(rom_file_read("./check_gbe_rom.zip", second, size));
+  ck_assert_mem_eq(first, second, size);
+
+  /* A truncated image is a miss, the archive's own size is used and the
+   * image is stored again */
+  write_file(archive_p, archive, archive_len);
+  utime(archive_p, &times);
+  write_file(image_path, first, 100);
+  ck_assert(rom_file_size(archive_p, &size));
+  ck_assert_uint_eq(size, sizeof(first));
+  memset(second, 0, sizeof(second));
+  ck_assert(rom_file_read(archive_p, second, size));
+  ck_assert_mem_eq(first, second, size);
+  stat(image_path, &image_stat);
+  ck_assert_int_eq(image_stat.st_size, size);
+
+  /* So is an image that no longer matches its hash */
+  write_file(image_path, garbage, size);
+  ck_assert(rom_file_size(archive_p, &size));
+  ck_assert(rom_file_read(archive_p, second, size));
+  ck_assert_mem_eq(first, second, size);
+  unsetenv(ROM_CACHE_ENV);
+  remove(archive_p);
+
+  /* One image and one index entry */
+  int files = 0;
+  DIR *dir_p = opendir(cache_p);
+  struct dirent *entry_p;
+  while ((entry_p = readdir(dir_p)) != NULL) {
+    if (entry_p->d_name[0] != '.') {
+      snprintf(image_path, sizeof(image_path), "%s/%s", cache_p,
+               entry_p->d_name);
+      remove(image_path);
+      files++;
+    }
+  }
+  closedir(dir_p);
+  remove(cache_p);
+
+  ck_assert_int_eq(files, 2);
 }
 END_TEST
 
@@ -205,13 +443,916 @@ START_TEST(test_cpu_init) {
   cpu_init(&ctx);
 
   ck_assert_uint_eq(ctx.regs.pc, 0x100);
-  ck_assert_uint_eq(ctx.regs.a, 0x01);
+  ck_assert_uint_eq(ctx.regs.sp, 0xFFFE);
+  ck_assert_uint_eq(get_reg_pair(&ctx.regs, REG_PAIR_AF), 0x01B0);
+  ck_assert_uint_eq(get_reg_pair(&ctx.regs, REG_PAIR_BC), 0x0013);
+  ck_assert_uint_eq(get_reg_pair(&ctx.regs, REG_PAIR_DE), 0x00D8);
+  ck_assert_uint_eq(get_reg_pair(&ctx.regs, REG_PAIR_HL), 0x014D);
+}
+END_TEST
+
+/**
+ * Boot Test Suite
+ */
+START_TEST(test_boot_skip) {
+  cart_t cart = load_cart("../roms/tests/blargg/cpu_instrs.gb");
+  cpu_ctx_t ctx = {};
+  static mem_t mem;
+
+  boot_skip(&ctx, &mem, &cart.metadata);
+
+  ck_assert_uint_eq(ctx.regs.pc, 0x100);
+  ck_assert_uint_eq(ctx.regs.f, 0xB0);
+  ck_assert_uint_eq(mem.io[REG_LCDC], 0x91);
+  ck_assert_uint_eq(mem.io[REG_DIV], 0xAB);
+  ck_assert_uint_eq(mem.io[REG_BGP], 0xFC);
+  ck_assert_uint_eq(mem.io[REG_BOOT], 0x01);
+  /* Unused register */
+  ck_assert_uint_eq(mem.io[IO_REG(0xFF03)], 0xFF);
+
+  unload_cart(&cart);
+}
+END_TEST
+
+START_TEST(test_boot_skip_zero_checksum) {
+  cart_metadata_t metadata = {.checksum = 0x00};
+  cpu_ctx_t ctx = {};
+  static mem_t mem;
+
+  boot_skip(&ctx, &mem, &metadata);
+
+  ck_assert_uint_eq(ctx.regs.f, 0x80);
+}
+END_TEST
+
+START_TEST(test_boot_skip_logo) {
+  cart_t cart = load_cart("../roms/tests/blargg/cpu_instrs.gb");
+  cpu_ctx_t ctx = {};
+  static mem_t mem;
+
+  boot_skip(&ctx, &mem, &cart.metadata);
+
+  /* The logo starts with 0xCE: each nibble is widened to a byte and written
+   * on two rows of bit plane 0. */
+  ck_assert_uint_eq(mem.vram[0x0010], 0xF0);
+  ck_assert_uint_eq(mem.vram[0x0011], 0x00);
+  ck_assert_uint_eq(mem.vram[0x0012], 0xF0);
+  ck_assert_uint_eq(mem.vram[0x0014], 0xFC);
+  /* (R) tile */
+  ck_assert_uint_eq(mem.vram[0x0190], 0x3C);
+  /* Tile map */
+  ck_assert_uint_eq(mem.vram[0x1904], 0x01);
+  ck_assert_uint_eq(mem.vram[0x190F], 0x0C);
+  ck_assert_uint_eq(mem.vram[0x1910], 0x19);
+  ck_assert_uint_eq(mem.vram[0x1924], 0x0D);
+  ck_assert_uint_eq(mem.vram[0x192F], 0x18);
+
+  unload_cart(&cart);
+}
+END_TEST
+
+/**
+ * State hash Test Suite
+ */
+START_TEST(test_state_hash_bytes) {
+  /* Reference FNV-1a 32-bit values */
+  ck_assert_uint_eq(state_hash_bytes(STATE_HASH_INIT, NULL, 0), 0x811C9DC5);
+  ck_assert_uint_eq(state_hash_bytes(STATE_HASH_INIT, (const u8 *)"a", 1),
+                    0xE40C292C);
+  ck_assert_uint_eq(state_hash_bytes(STATE_HASH_INIT, (const u8 *)"foobar", 6),
+                    0xBF9CF968);
+}
+END_TEST
+
+START_TEST(test_state_hash_cpu) {
+  cpu_ctx_t ctx = {};
+  cpu_init(&ctx);
+  u32 initial = state_hash_cpu(&ctx);
+
+  ctx.regs.sp ^= 0x0100;
+
+  ck_assert_uint_ne(state_hash_cpu(&ctx), initial);
+}
+END_TEST
+
+START_TEST(test_state_hash_log_round_trip) {
+  FILE *file_p = tmpfile();
+  state_hash_record_t expected = {.frame = 42, .hashes = {1, 0xCAFEBABE, 3}};
+  state_hash_record_t actual;
+
+  ck_assert(state_hash_write_header(file_p));
+  ck_assert(state_hash_write_record(file_p, &expected));
+  rewind(file_p);
+
+  ck_assert(state_hash_read_header(file_p));
+  ck_assert(state_hash_read_record(file_p, &actual));
+  ck_assert_uint_eq(actual.frame, 42);
+  ck_assert_uint_eq(actual.hashes[STATE_HASH_RAM], 0xCAFEBABE);
+  ck_assert(!state_hash_read_record(file_p, &actual));
+
+  /* Logs from before the CPU hash covered the cycle count are rejected */
+  const u8 VERSION_1[] = {'G', 'B', 'S', 'H', 1, 0, 3, 0};
+  rewind(file_p);
+  fwrite(VERSION_1, sizeof(VERSION_1), 1, file_p);
+  rewind(file_p);
+  ck_assert(!state_hash_read_header(file_p));
+
+  fclose(file_p);
+}
+END_TEST
+
+START_TEST(test_state_hash_diff) {
+  cpu_ctx_t ctx = {};
+  u8 ram[16] = {};
+  state_snapshot_t snapshot = {
+      .cpu_p = &ctx, .ram_p = ram, .ram_len = sizeof(ram)};
+  FILE *expected_p = tmpfile();
+  FILE *actual_p = tmpfile();
+  state_hash_record_t record;
+  state_hash_divergence_t divergence;
+
+  state_hash_write_header(expected_p);
+  state_hash_write_header(actual_p);
+  for (u32 frame = 0; frame < 4; frame++) {
+    state_hash_frame(&record, frame, &snapshot);
+    state_hash_write_record(expected_p, &record);
+
+    if (frame == 2) {
+      ram[7] = 0xFF;
+    }
+    state_hash_frame(&record, frame, &snapshot);
+    state_hash_write_record(actual_p, &record);
+  }
+  rewind(expected_p);
+  rewind(actual_p);
+
+  ck_assert_int_eq(state_hash_diff(expected_p, actual_p, &divergence),
+                   STATE_HASH_DIFF_DIVERGED);
+  ck_assert_uint_eq(divergence.frame, 2);
+  ck_assert_int_eq(divergence.component, STATE_HASH_RAM);
+
+  fclose(expected_p);
+  fclose(actual_p);
+}
+END_TEST
+
+/**
+ * Scheduler Test Suite
+ */
+START_TEST(test_sched_next) {
+  sched_t sched;
+  sched_event_type_t type;
+
+  sched_init(&sched);
+  ck_assert_uint_eq(sched_next(&sched, NULL), SCHED_NEVER);
+
+  sched_add(&sched, SCHED_EVENT_VBLANK, 70224, 0, INT_VBLANK);
+  sched_add(&sched, SCHED_EVENT_TIMER, 1024, 0, INT_TIMER);
+
+  ck_assert_uint_eq(sched_next(&sched, &type), 1024);
+  ck_assert_int_eq(type, SCHED_EVENT_TIMER);
+
+  sched_cancel(&sched, SCHED_EVENT_TIMER);
+  ck_assert_uint_eq(sched_next(&sched, &type), 70224);
+  ck_assert_int_eq(type, SCHED_EVENT_VBLANK);
+
+  /* Firing "forever" with nothing scheduled does nothing */
+  u8 if_reg = 0x00;
+  sched_init(&sched);
+  ck_assert_uint_eq(sched_fire_due(&sched, SCHED_NEVER, &if_reg), 0);
+}
+END_TEST
+
+static void count_event(void *user_p, u64 when) { (*(int *)user_p)++; }
+
+START_TEST(test_sched_fire_due_periodic) {
+  sched_t sched;
+  u8 if_reg = 0x00;
+  int fired = 0;
+
+  sched_init(&sched);
+  sched_add(&sched, SCHED_EVENT_LY, 456, 456, 0);
+  sched_set_handler(&sched, SCHED_EVENT_LY, count_event, &fired);
+  sched_add(&sched, SCHED_EVENT_TIMER, 500, 0, INT_TIMER);
+
+  ck_assert_uint_eq(sched_fire_due(&sched, 456 * 3, &if_reg), INT_TIMER);
+
+  ck_assert_int_eq(fired, 3);
+  ck_assert_uint_eq(if_reg, INT_TIMER);
+  ck_assert_uint_eq(sched_next(&sched, NULL), 456 * 4);
+}
+END_TEST
+
+/**
+ * Idle Test Suite
+ */
+START_TEST(test_cpu_halt_bug) {
+  cpu_ctx_t ctx = {};
+  cpu_init(&ctx);
+
+  cpu_halt(&ctx, INT_VBLANK, INT_VBLANK);
+
+  ck_assert(!ctx.halted);
+  ck_assert(ctx.halt_bug);
+}
+END_TEST
+
+START_TEST(test_idle_skip_halt) {
+  cpu_ctx_t ctx = {};
+  static mem_t mem;
+  sched_t sched;
+
+  cpu_init(&ctx);
+  ctx.cycles = 100;
+  mem.ie = INT_VBLANK;
+  sched_init(&sched);
+  /* The timer fires first but is not enabled, so it must not wake the CPU */
+  sched_add(&sched, SCHED_EVENT_TIMER, 1000, 0, INT_TIMER);
+  sched_add(&sched, SCHED_EVENT_VBLANK, 65664, 70224, INT_VBLANK);
+
+  cpu_halt(&ctx, mem.ie, mem.io[REG_IF]);
+  ck_assert(ctx.halted);
+
+  ck_assert(idle_skip_halt(&ctx, &mem, &sched, 70224));
+
+  ck_assert(!ctx.halted);
+  ck_assert_uint_eq(ctx.cycles, 65664);
+  ck_assert_uint_eq(mem.io[REG_IF], INT_VBLANK | INT_TIMER);
+}
+END_TEST
+
+START_TEST(test_idle_skip_halt_limit) {
+  cpu_ctx_t ctx = {};
+  static mem_t mem;
+  sched_t sched;
+
+  cpu_init(&ctx);
+  mem.ie = 0x00;
+  sched_init(&sched);
+  sched_add(&sched, SCHED_EVENT_VBLANK, 65664, 70224, INT_VBLANK);
+  ctx.halted = true;
+
+  ck_assert(!idle_skip_halt(&ctx, &mem, &sched, 70224 * 2));
+
+  ck_assert(ctx.halted);
+  ck_assert_uint_eq(ctx.cycles, 70224 * 2);
+}
+END_TEST
+
+START_TEST(test_idle_detect_poll) {
+  /* ldh a, [rLY]; cp 144; jr nz, -6 */
+  const u8 wait_ly[] = {0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA};
+  /* ld a, [rSTAT]; and 3; jr nz, -7 */
+  const u8 wait_hblank[] = {0xFA, 0x41, 0xFF, 0xE6, 0x03, 0x20, 0xF9};
+  /* ldh a, [rLY]; cp 144; jr c, -6 */
+  const u8 wait_vblank_lines[] = {0xF0, 0x44, 0xFE, 0x90, 0x38, 0xFA};
+  /* Polling the joypad is not idle */
+  const u8 wait_joypad[] = {0xF0, 0x00, 0xFE, 0x90, 0x20, 0xFA};
+  /* Jumps elsewhere */
+  const u8 not_a_loop[] = {0xF0, 0x44, 0xFE, 0x90, 0x20, 0xF0};
+  idle_loop_t loop;
+
+  ck_assert(idle_detect_poll(wait_ly, sizeof(wait_ly), &loop));
+  ck_assert_uint_eq(loop.reg, REG_LY);
+  ck_assert_int_eq(loop.exit, IDLE_EXIT_EQUAL);
+  ck_assert_uint_eq(loop.iteration_cycles, 32);
+  ck_assert(!idle_poll_exits(&loop, 143));
+  ck_assert(idle_poll_exits(&loop, 144));
+
+  ck_assert(idle_detect_poll(wait_hblank, sizeof(wait_hblank), &loop));
+  ck_assert_uint_eq(loop.reg, REG_STAT);
+  ck_assert_uint_eq(loop.iteration_cycles, 36);
+  ck_assert(!idle_poll_exits(&loop, 0x83));
+  ck_assert(idle_poll_exits(&loop, 0x80));
+
+  ck_assert(idle_detect_poll(wait_vblank_lines, sizeof(wait_vblank_lines),
+                             &loop));
+  ck_assert(idle_poll_exits(&loop, 150));
+
+  ck_assert(!idle_detect_poll(wait_joypad, sizeof(wait_joypad), &loop));
+  ck_assert(!idle_detect_poll(not_a_loop, sizeof(not_a_loop), &loop));
+  ck_assert(!idle_detect_poll(wait_ly, sizeof(wait_ly) - 1, &loop));
+}
+END_TEST
+
+static void next_line(void *user_p, u64 when) {
+  mem_t *mem_p = user_p;
+  mem_p->io[REG_LY] = (mem_p->io[REG_LY] + 1) % 154;
+}
+
+START_TEST(test_idle_skip_poll) {
+  const u8 wait_ly[] = {0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA};
+  cpu_ctx_t ctx = {};
+  static mem_t mem;
+  sched_t sched;
+  idle_loop_t loop;
+
+  cpu_init(&ctx);
+  mem.io[REG_LY] = 0;
+  sched_init(&sched);
+  sched_add(&sched, SCHED_EVENT_LY, 456, 456, 0);
+  sched_set_handler(&sched, SCHED_EVENT_LY, next_line, &mem);
+  idle_detect_poll(wait_ly, sizeof(wait_ly), &loop);
+
+  u64 skipped = idle_skip_poll(&ctx, &mem, &sched, &loop, 70224);
+
+  ck_assert_uint_eq(mem.io[REG_LY], 144);
+  ck_assert_uint_ge(ctx.cycles, 456 * 144);
+  ck_assert_uint_lt(ctx.cycles, 456 * 144 + loop.iteration_cycles);
+  ck_assert_uint_eq(skipped % loop.iteration_cycles, 0);
+
+  /* No limit: stops at the next line instead of overflowing */
+  ctx.cycles = 0;
+  mem.io[REG_LY] = 0;
+  sched_add(&sched, SCHED_EVENT_LY, 456, 0, 0);
+  loop.operand = 1;
+  skipped = idle_skip_poll(&ctx, &mem, &sched, &loop, SCHED_NEVER);
+  ck_assert_uint_eq(mem.io[REG_LY], 1);
+  ck_assert_uint_ge(ctx.cycles, 456);
+  ck_assert_uint_lt(ctx.cycles, 456 + loop.iteration_cycles);
+}
+END_TEST
+
+/**
+ * Sprite Test Suite
+ */
+START_TEST(test_sprite_cache_line_limit_and_priority) {
+  static mem_t mem;
+  sprite_cache_t cache;
+  u8 count;
+
+  sprite_cache_init(&cache);
+  /* 12 sprites on line 0 with decreasing X */
+  for (int i = 0; i < 12; i++) {
+    sprite_oam_write(&cache, &mem, OAM_START + i * 4, 16);
+    sprite_oam_write(&cache, &mem, OAM_START + i * 4 + 1, 100 - i);
+  }
+  /* Same X as sprite 9: OAM order breaks the tie */
+  sprite_oam_write(&cache, &mem, OAM_START + 1, 91);
+
+  const u8 *list_p = sprite_cache_line(&cache, &mem, 0, &count);
+
+  /* Sprites 10 and 11 are dropped despite their smaller X */
+  ck_assert_uint_eq(count, 10);
+  ck_assert_uint_eq(list_p[0], 0);
+  ck_assert_uint_eq(list_p[1], 9);
+  ck_assert_uint_eq(list_p[2], 8);
+  ck_assert_uint_eq(list_p[9], 1);
+
+  /* Line 8 is past the bottom of 8x8 sprites at Y=16 */
+  sprite_cache_line(&cache, &mem, 8, &count);
+  ck_assert_uint_eq(count, 0);
+}
+END_TEST
+
+START_TEST(test_sprite_cache_invalidation) {
+  static mem_t mem;
+  sprite_cache_t cache;
+  u8 count;
+
+  sprite_cache_init(&cache);
+  sprite_oam_write(&cache, &mem, OAM_START, 20);
+  sprite_cache_line(&cache, &mem, 4, &count);
+  ck_assert_uint_eq(count, 1);
+  ck_assert(!cache.dirty);
+
+  /* Rewriting the same value keeps the lists */
+  sprite_oam_write(&cache, &mem, OAM_START, 20);
+  ck_assert(!cache.dirty);
+
+  /* 8x16 sprites reach 8 more lines */
+  sprite_cache_line(&cache, &mem, 12, &count);
+  ck_assert_uint_eq(count, 0);
+  mem.io[REG_LCDC] = 0x04;
+  sprite_cache_line(&cache, &mem, 12, &count);
+  ck_assert_uint_eq(count, 1);
+
+  sprite_oam_write(&cache, &mem, OAM_START, 0);
+  ck_assert(cache.dirty);
+  sprite_cache_line(&cache, &mem, 4, &count);
+  ck_assert_uint_eq(count, 0);
+}
+END_TEST
+
+/**
+ * DMA Test Suite
+ */
+START_TEST(test_dma_transfer) {
+  static mem_t mem;
+  sprite_cache_t cache;
+  sched_t sched;
+  dma_t dma;
+
+  sched_init(&sched);
+  sprite_cache_init(&cache);
+  dma_init(&dma, &sched, &mem, &cache);
+  for (int i = 0; i < OAM_SIZE; i++) {
+    mem.wram[0x100 + i] = i;
+  }
+  sprite_cache_line(&cache, &mem, 0, &(u8){0});
+
+  dma_start(&dma, &sched, NULL, 0xC1, 1000);
+
+  ck_assert(!dma_bus_conflict(&dma, 0xC000, 1000));
+  ck_assert(dma_bus_conflict(&dma, 0xC000, 1004));
+  ck_assert(!dma_bus_conflict(&dma, HRAM_START, 1004));
+  ck_assert(!dma_bus_conflict(&dma, REG_IF + IO_START, 1004));
+  /* Same bus as the WRAM source: reads see the byte being copied */
+  ck_assert(dma_bus_conflict(&dma, 0x4000, 1004));
+  ck_assert(dma_bus_conflict(&dma, 0xA000, 1004));
+  ck_assert_uint_eq(dma_conflict_value(&dma, 0x4000, 1004 + 4 * 10), 10);
+  /* The video bus is free */
+  ck_assert(!dma_bus_conflict(&dma, VRAM_START, 1004));
+  /* OAM reads 0xFF */
+  ck_assert(dma_bus_conflict(&dma, OAM_START, 1004));
+  ck_assert_uint_eq(dma_conflict_value(&dma, OAM_START + 3, 1004 + 4 * 10),
+                    0xFF);
+
+  sched_fire_due(&sched, 1000 + DMA_CYCLES - 1, &mem.io[REG_IF]);
+  ck_assert(dma.active);
+  ck_assert_uint_eq(mem.oam[OAM_SIZE - 1], 0);
+
+  sched_fire_due(&sched, 1000 + DMA_CYCLES, &mem.io[REG_IF]);
+  ck_assert(!dma.active);
+  ck_assert(cache.dirty);
+  ck_assert_mem_eq(mem.oam, &mem.wram[0x100], OAM_SIZE);
+  ck_assert(!dma_bus_conflict(&dma, 0xC000, 1000 + DMA_CYCLES));
+
+  /* From VRAM, the external bus is free instead */
+  mem.vram[5] = 0x42;
+  dma_start(&dma, &sched, NULL, 0x80, 2000);
+  ck_assert(dma_bus_conflict(&dma, VRAM_START + 0x1800, 2004));
+  ck_assert_uint_eq(dma_conflict_value(&dma, VRAM_START, 2004 + 4 * 5), 0x42);
+  ck_assert(!dma_bus_conflict(&dma, 0xC000, 2004));
+  ck_assert(!dma_bus_conflict(&dma, 0x0150, 2004));
+  ck_assert(dma_bus_conflict(&dma, OAM_START + OAM_SIZE - 1, 2004));
+
+  /* Page 0xFF mirrors WRAM: the external bus is busy, I/O and HRAM are not */
+  dma_start(&dma, &sched, NULL, 0xFF, 3000);
+  ck_assert_uint_eq(dma.bus, DMA_BUS_EXTERNAL);
+  ck_assert(dma_bus_conflict(&dma, 0xC000, 3004));
+  ck_assert(!dma_bus_conflict(&dma, HRAM_START, 3004));
+  ck_assert(!dma_bus_conflict(&dma, REG_IF + IO_START, 3004));
+}
+END_TEST
+
+START_TEST(test_dma_source) {
+  cart_t cart = load_cart("../roms/tests/blargg/cpu_instrs.gb");
+  static mem_t mem;
+
+  ck_assert_ptr_eq(dma_source(&mem, &cart, 0x01), cart.rom_p + 0x100);
+  ck_assert_ptr_eq(dma_source(&mem, &cart, 0x80), mem.vram);
+  /* No cartridge RAM allocated, then only as much as the cartridge has */
+  ck_assert_ptr_eq(dma_source(&mem, &cart, 0xA0), NULL);
+  u8 ram[0x2000];
+  cart.ram_p = ram;
+  cart.ram_size_bytes = sizeof(ram);
+  ck_assert_ptr_eq(dma_source(&mem, &cart, 0xA1), &ram[0x100]);
+  ck_assert_ptr_eq(dma_source(&mem, &cart, 0xBF), &ram[0x1F00]);
+  cart.ram_size_bytes = 0x800;
+  ck_assert_ptr_eq(dma_source(&mem, &cart, 0xA8), NULL);
+  cart.ram_p = NULL;
+  ck_assert_ptr_eq(dma_source(&mem, &cart, 0xD0), &mem.wram[0x1000]);
+  ck_assert_ptr_eq(dma_source(&mem, &cart, 0xE0), mem.wram);
+
+  unload_cart(&cart);
+}
+END_TEST
+
+/**
+ * Trace Test Suite
+ */
+START_TEST(test_trace_round_trip) {
+  const char *path_p = "check_gbe_trace.bin";
+  const u32 RECORDS = 10000;
+  cpu_ctx_t ctx = {};
+  trace_t trace;
+  trace_record_t record;
+
+  cpu_init(&ctx);
+  /* A tiny ring makes the emulation side wait for the writer */
+  ck_assert(trace_open(&trace, path_p, 4));
+  for (u32 i = 0; i < RECORDS; i++) {
+    u8 pcmem[4] = {i & 0xFF, 0xC3, 0x13, 0x02};
+    ctx.cycles = i * 4;
+    ctx.regs.pc = 0x100 + i;
+    trace_record(&trace, &ctx, pcmem);
+  }
+  trace_close(&trace);
+
+  FILE *file_p = fopen(path_p, "rb");
+  ck_assert(file_p != NULL);
+  ck_assert(trace_read_header(file_p));
+  for (u32 i = 0; i < RECORDS; i++) {
+    ck_assert(trace_read_record(file_p, &record));
+    ck_assert_uint_eq(record.cycles, i * 4);
+    ck_assert_uint_eq(record.pc, (u16)(0x100 + i));
+    ck_assert_uint_eq(record.pcmem[0], i & 0xFF);
+    ck_assert_uint_eq(record.sp, 0xFFFE);
+  }
+  ck_assert(!trace_read_record(file_p, &record));
+  fclose(file_p);
+  remove(path_p);
+}
+END_TEST
+
+START_TEST(test_trace_errors) {
+  cpu_ctx_t ctx = {};
+  trace_t trace;
+  u8 pcmem[4] = {0};
+
+  ck_assert(!trace_open(&trace, "check_gbe_trace.bin",
+                        TRACE_MAX_CAPACITY_LOG2 + 1));
+  trace_close(&trace);
+  ck_assert(!trace_open(&trace, "missing/check_gbe_trace.bin", 4));
+  trace_close(&trace);
+
+  /* Writes fail once the stdio buffer is flushed, recording carries on */
+  cpu_init(&ctx);
+  ck_assert(trace_open(&trace, "/dev/full", 4));
+  for (int i = 0; i < 100000; i++) {
+    trace_record(&trace, &ctx, pcmem);
+  }
+  trace_close(&trace);
+  ck_assert(trace.write_failed);
+  trace_close(&trace);
+}
+END_TEST
+
+START_TEST(test_trace_format_doctor) {
+  cpu_ctx_t ctx = {};
+  trace_record_t record;
+  u8 buf[TRACE_RECORD_BYTES];
+  char line[128];
+
+  cpu_init(&ctx);
+  record = (trace_record_t){.pc = ctx.regs.pc, .sp = ctx.regs.sp,
+                            .a = ctx.regs.a, .f = ctx.regs.f,
+                            .b = ctx.regs.b, .c = ctx.regs.c,
+                            .d = ctx.regs.d, .e = ctx.regs.e,
+                            .h = ctx.regs.h, .l = ctx.regs.l,
+                            .pcmem = {0x00, 0xC3, 0x13, 0x02}};
+  trace_format_doctor(line, sizeof(line), &record);
+
+  ck_assert_str_eq(line, "A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE "
+                         "PC:0100 PCMEM:00,C3,13,02");
+
+  trace_encode_record(buf, &record);
+  ck_assert_uint_eq(buf[8], 0x00);
+  ck_assert_uint_eq(buf[9], 0x01);
+  ck_assert_uint_eq(buf[21], 0xC3);
+}
+END_TEST
+
+/**
+ * Instance Test Suite
+ */
+START_TEST(test_emu_create) {
+  emu_t *emu_p = emu_create("../roms/tests/archives/cpu_instrs.gb.gz");
+
+  ck_assert(emu_p != NULL);
+  ck_assert_uint_eq((uintptr_t)emu_p % EMU_ARENA_ALIGN, 0);
+  ck_assert_uint_eq((uintptr_t)emu_p->mem_p % EMU_ARENA_ALIGN, 0);
+  ck_assert_uint_eq((uintptr_t)emu_p->cart.rom_p % EMU_ARENA_ALIGN, 0);
+  ck_assert_uint_eq((uintptr_t)emu_p->cart.ram_p % EMU_ARENA_ALIGN, 0);
+  ck_assert(emu_p->cart.ram_p > (u8 *)emu_p->mem_p);
+  ck_assert(emu_p->cart.ram_p + CART_RAM_MAX_BYTES <= emu_p->cart.rom_p);
+  /* cpu_instrs has no cartridge RAM */
+  ck_assert_uint_eq(emu_p->cart.ram_size_bytes, 0);
+  ck_assert((u8 *)emu_p->cart.rom_p + emu_p->cart.rom_size_bytes <=
+            (u8 *)emu_p + emu_p->arena_bytes);
+  ck_assert_str_eq(emu_p->cart.metadata.title, "CPU_INSTRS");
+
+  /* Booted, with DMA wired to the instance's own memory */
+  ck_assert_uint_eq(emu_p->cpu.regs.pc, 0x100);
+  ck_assert_uint_eq(emu_p->mem_p->io[REG_LCDC], 0x91);
+  dma_start(&emu_p->dma, &emu_p->sched, &emu_p->cart, 0x00, 0);
+  sched_fire_due(&emu_p->sched, DMA_CYCLES, &emu_p->mem_p->io[REG_IF]);
+  ck_assert_mem_eq(emu_p->mem_p->oam, emu_p->cart.rom_p, OAM_SIZE);
+
+  emu_destroy(emu_p);
+}
+END_TEST
+
+START_TEST(test_emu_create_missing_rom) {
+  ck_assert(emu_create("../roms/tests/missing.gb") == NULL);
+  ck_assert(emu_create("../roms/tests/archives") == NULL);
+  emu_destroy(NULL);
+}
+END_TEST
+
+/**
+ * Link Test Suite
+ */
+typedef struct link_side {
+  mem_t mem;
+  sched_t sched;
+  link_t link;
+} link_side_t;
+
+static void link_side_init(link_side_t *side_p, u8 sb) {
+  memset(&side_p->mem, 0, sizeof(mem_t));
+  sched_init(&side_p->sched);
+  link_init(&side_p->link, &side_p->sched, &side_p->mem);
+  side_p->mem.io[REG_SB] = sb;
+}
+
+START_TEST(test_link_unconnected) {
+  link_side_t side;
+
+  link_side_init(&side, 0x42);
+  link_serial_control(&side.link, 0x81, 100);
+  ck_assert_uint_eq(side.mem.io[REG_SC], 0xFF);
+  ck_assert_uint_eq(sched_fire_due(&side.sched, 100 + LINK_TRANSFER_CYCLES - 1,
+                                   &side.mem.io[REG_IF]),
+                    0);
+  ck_assert_uint_eq(side.mem.io[REG_SC] & SC_TRANSFER, SC_TRANSFER);
+
+  sched_fire_due(&side.sched, 100 + LINK_TRANSFER_CYCLES,
+                 &side.mem.io[REG_IF]);
+  ck_assert_uint_eq(side.mem.io[REG_SB], 0xFF);
+  ck_assert_uint_eq(side.mem.io[REG_SC], 0x7F);
+  ck_assert_uint_eq(side.mem.io[REG_IF], INT_SERIAL);
+}
+END_TEST
+
+START_TEST(test_link_exchange) {
+  link_cable_t *cable_p = link_cable_create();
+  link_side_t master, slave, extra;
+
+  link_side_init(&master, 0x12);
+  link_side_init(&slave, 0x34);
+  link_side_init(&extra, 0x56);
+  ck_assert(link_connect(&master.link, cable_p, 1000));
+  ck_assert(link_connect(&slave.link, cable_p, 0));
+  ck_assert(!link_connect(&extra.link, cable_p, 0));
+
+  /* The slave only shifts once its own clock reaches the end of the
+   * transfer, counted from when each side connected */
+  link_serial_control(&slave.link, 0x80, 0);
+  link_serial_control(&master.link, 0x81, 1100);
+  link_poll(&slave.link, 100 + LINK_TRANSFER_CYCLES - 1);
+  ck_assert_uint_eq(slave.mem.io[REG_SB], 0x34);
+  link_poll(&slave.link, 100 + LINK_TRANSFER_CYCLES);
+  ck_assert_uint_eq(slave.mem.io[REG_SB], 0x12);
+  ck_assert_uint_eq(slave.mem.io[REG_SC] & SC_TRANSFER, 0);
+  ck_assert_uint_eq(slave.mem.io[REG_IF], INT_SERIAL);
+
+  sched_fire_due(&master.sched, 1100 + LINK_TRANSFER_CYCLES,
+                 &master.mem.io[REG_IF]);
+  ck_assert_uint_eq(master.mem.io[REG_SB], 0x34);
+  ck_assert_uint_eq(master.mem.io[REG_IF], INT_SERIAL);
+
+  /* A peer without a pending transfer shifts in 0xFF */
+  link_serial_control(&master.link, 0x81, 6000);
+  link_poll(&slave.link, 5000 + LINK_TRANSFER_CYCLES);
+  sched_fire_due(&master.sched, 6000 + LINK_TRANSFER_CYCLES,
+                 &master.mem.io[REG_IF]);
+  ck_assert_uint_eq(master.mem.io[REG_SB], 0xFF);
+  ck_assert_uint_eq(slave.mem.io[REG_SB], 0x12);
+
+  /* Both ends clocking at once swap bytes instead of deadlocking */
+  master.mem.io[REG_SB] = 0xAA;
+  slave.mem.io[REG_SB] = 0x55;
+  link_serial_control(&master.link, 0x81, 11000);
+  link_serial_control(&slave.link, 0x81, 10000);
+  link_poll(&slave.link, 10000 + LINK_TRANSFER_CYCLES);
+  sched_fire_due(&master.sched, 11000 + LINK_TRANSFER_CYCLES,
+                 &master.mem.io[REG_IF]);
+  sched_fire_due(&slave.sched, 10000 + LINK_TRANSFER_CYCLES,
+                 &slave.mem.io[REG_IF]);
+  ck_assert_uint_eq(master.mem.io[REG_SB], 0x55);
+  ck_assert_uint_eq(slave.mem.io[REG_SB], 0xAA);
+
+  /* The master reaches its end before the slave's transfer is due, so it
+   * waits, answering the slave meanwhile */
+  master.mem.io[REG_IF] = 0;
+  link_serial_control(&master.link, 0x81, 21000);
+  link_serial_control(&slave.link, 0x81, 20100);
+  sched_fire_due(&master.sched, 21000 + LINK_TRANSFER_CYCLES,
+                 &master.mem.io[REG_IF]);
+  ck_assert(link_waiting(&master.link));
+  ck_assert_uint_eq(master.mem.io[REG_SC] & SC_TRANSFER, SC_TRANSFER);
+  ck_assert_uint_eq(master.mem.io[REG_IF], 0);
+  link_poll(&master.link, 21000 + LINK_TRANSFER_CYCLES);
+  ck_assert(link_waiting(&master.link));
+
+  sched_fire_due(&slave.sched, 20100 + LINK_TRANSFER_CYCLES,
+                 &slave.mem.io[REG_IF]);
+  ck_assert(!link_waiting(&slave.link));
+  ck_assert_uint_eq(slave.mem.io[REG_SB], 0x55);
+  link_poll(&master.link, 21000 + LINK_TRANSFER_CYCLES);
+  ck_assert(!link_waiting(&master.link));
+  ck_assert_uint_eq(master.mem.io[REG_SB], 0xAA);
+  ck_assert_uint_eq(master.mem.io[REG_SC] & SC_TRANSFER, 0);
+  ck_assert_uint_eq(master.mem.io[REG_IF], INT_SERIAL);
+
+  /* A freed end can be reused */
+  link_disconnect(&slave.link);
+  ck_assert(link_connect(&extra.link, cable_p, 0));
+  link_disconnect(&extra.link);
+  link_disconnect(&master.link);
+  link_cable_destroy(cable_p);
+}
+END_TEST
+
+#define LINK_THREAD_BYTES 64
+
+typedef struct link_slave {
+  link_side_t side;
+  u8 received[LINK_THREAD_BYTES];
+} link_slave_t;
+
+/* Answers LINK_THREAD_BYTES transfers with the external clock, running its
+ * own clock freely */
+static void *link_slave_thread(void *arg_p) {
+  link_slave_t *slave_p = arg_p;
+  link_side_t *side_p = &slave_p->side;
+  u64 now = 0;
+
+  for (int i = 0; i < LINK_THREAD_BYTES; i++) {
+    side_p->mem.io[REG_SB] = 0x80 + i;
+    link_serial_control(&side_p->link, 0x80, now);
+    while (side_p->mem.io[REG_SC] & SC_TRANSFER) {
+      now += 4;
+      link_poll(&side_p->link, now);
+    }
+    slave_p->received[i] = side_p->mem.io[REG_SB];
+  }
+
+  return NULL;
+}
+
+START_TEST(test_link_threads) {
+  link_cable_t *cable_p = link_cable_create();
+  link_side_t master;
+  link_slave_t slave;
+  pthread_t thread;
+
+  link_side_init(&master, 0);
+  link_side_init(&slave.side, 0);
+  ck_assert(link_connect(&master.link, cable_p, 0));
+  ck_assert(link_connect(&slave.side.link, cable_p, 0));
+  ck_assert_int_eq(pthread_create(&thread, NULL, link_slave_thread, &slave),
+                   0);
+
+  /* Each completion waits until the slave thread has answered */
+  u64 now = 0;
+  for (int i = 0; i < LINK_THREAD_BYTES; i++) {
+    master.mem.io[REG_SB] = i;
+    link_serial_control(&master.link, 0x81, now);
+    now += LINK_TRANSFER_CYCLES;
+    sched_fire_due(&master.sched, now, &master.mem.io[REG_IF]);
+    while (link_waiting(&master.link)) {
+      link_poll(&master.link, now);
+    }
+    ck_assert_uint_eq(master.mem.io[REG_SB], 0x80 + i);
+  }
+
+  pthread_join(thread, NULL);
+  for (int i = 0; i < LINK_THREAD_BYTES; i++) {
+    ck_assert_uint_eq(slave.received[i], i);
+  }
+
+  link_disconnect(&slave.side.link);
+  link_disconnect(&master.link);
+  link_cable_destroy(cable_p);
+}
+END_TEST
+
+START_TEST(test_link_halted) {
+  link_cable_t *cable_p = link_cable_create();
+  link_side_t master, slave;
+  cpu_ctx_t ctx = {};
+
+  link_side_init(&master, 0x12);
+  link_side_init(&slave, 0x34);
+  ck_assert(link_connect(&master.link, cable_p, 0));
+  ck_assert(link_connect(&slave.link, cable_p, 0));
+
+  /* A slave sleeping until the serial interrupt wakes at the exact end of
+   * the master's transfer */
+  cpu_init(&ctx);
+  slave.mem.ie = INT_SERIAL;
+  link_serial_control(&slave.link, 0x80, 0);
+  link_serial_control(&master.link, 0x81, 300);
+  cpu_halt(&ctx, slave.mem.ie, slave.mem.io[REG_IF]);
+  ck_assert(ctx.halted);
+
+  ck_assert(idle_skip_halt(&ctx, &slave.mem, &slave.sched, 100000));
+  ck_assert_uint_eq(ctx.cycles, 300 + LINK_TRANSFER_CYCLES);
+  ck_assert_uint_eq(slave.mem.io[REG_SB], 0x12);
+
+  sched_fire_due(&master.sched, 300 + LINK_TRANSFER_CYCLES,
+                 &master.mem.io[REG_IF]);
+  ck_assert(!link_waiting(&master.link));
+  ck_assert_uint_eq(master.mem.io[REG_SB], 0x34);
+
+  /* A master sleeping until the serial interrupt stops at the end of its
+   * transfer while the slave has not answered, instead of running on */
+  u64 start = 300 + LINK_TRANSFER_CYCLES;
+  cpu_init(&ctx);
+  ctx.cycles = start;
+  master.mem.ie = INT_SERIAL;
+  master.mem.io[REG_IF] = 0;
+  master.mem.io[REG_SB] = 0x56;
+  slave.mem.io[REG_SB] = 0x78;
+  link_serial_control(&slave.link, 0x80, start);
+  link_serial_control(&master.link, 0x81, start);
+  cpu_halt(&ctx, master.mem.ie, master.mem.io[REG_IF]);
+
+  ck_assert(!idle_skip_halt(&ctx, &master.mem, &master.sched, 100000));
+  ck_assert_uint_eq(ctx.cycles, start + LINK_TRANSFER_CYCLES);
+  ck_assert(link_waiting(&master.link));
+  ck_assert(master.sched.stop);
+
+  link_poll(&slave.link, start + LINK_TRANSFER_CYCLES);
+  link_poll(&master.link, ctx.cycles);
+  ck_assert(!link_waiting(&master.link));
+  ck_assert(!master.sched.stop);
+  ck_assert(idle_skip_halt(&ctx, &master.mem, &master.sched, 100000));
+  ck_assert_uint_eq(ctx.cycles, start + LINK_TRANSFER_CYCLES);
+  ck_assert_uint_eq(master.mem.io[REG_SB], 0x78);
+  ck_assert_uint_eq(slave.mem.io[REG_SB], 0x56);
+
+  link_disconnect(&slave.link);
+  link_disconnect(&master.link);
+  link_cable_destroy(cable_p);
+}
+END_TEST
+
+START_TEST(test_link_dead_peer) {
+  link_cable_t *cable_p = link_cable_create();
+  link_side_t master, other;
+  pid_t pid = fork();
+
+  /* The pid of a process that exited, as left by a crashed instance */
+  if (pid == 0) {
+    _exit(0);
+  }
+  ck_assert(pid > 0);
+  ck_assert_int_eq(waitpid(pid, NULL, 0), pid);
+
+  link_side_init(&master, 0x12);
+  link_side_init(&other, 0x34);
+  ck_assert(link_connect(&master.link, cable_p, 0));
+  atomic_store(&cable_p->ports[1].owner_pid, pid);
+  atomic_store(&cable_p->ports[1].attached, true);
+
+  /* A transfer waiting on a dead peer shifts in 0xFF */
+  link_serial_control(&master.link, 0x81, 0);
+  sched_fire_due(&master.sched, LINK_TRANSFER_CYCLES, &master.mem.io[REG_IF]);
+  ck_assert(!link_waiting(&master.link));
+  ck_assert_uint_eq(master.mem.io[REG_SB], 0xFF);
+  ck_assert_uint_eq(master.mem.io[REG_IF], INT_SERIAL);
+
+  /* And its end is reclaimed */
+  ck_assert(link_connect(&other.link, cable_p, 0));
+  ck_assert_int_eq(other.link.port, 1);
+  ck_assert_int_eq(atomic_load(&cable_p->ports[1].owner_pid), getpid());
+
+  link_disconnect(&other.link);
+  link_disconnect(&master.link);
+  link_cable_destroy(cable_p);
+}
+END_TEST
+
+START_TEST(test_link_shared) {
+  char name[64];
+  link_side_t master, slave;
+
+  snprintf(name, sizeof(name), "/gbemu-check-%d", (int)getpid());
+  link_cable_t *first_p = link_cable_open_shared(name);
+  link_cable_t *second_p = link_cable_open_shared(name);
+  ck_assert(first_p != NULL);
+  ck_assert(second_p != NULL);
+
+  /* Two mappings of one object, as two processes would see it */
+  link_side_init(&master, 0x12);
+  link_side_init(&slave, 0x34);
+  ck_assert(link_connect(&master.link, first_p, 0));
+  ck_assert(link_connect(&slave.link, second_p, 0));
+  ck_assert_int_eq(slave.link.port, 1);
+
+  link_serial_control(&slave.link, 0x80, 0);
+  link_serial_control(&master.link, 0x81, 0);
+  link_poll(&slave.link, LINK_TRANSFER_CYCLES);
+  sched_fire_due(&master.sched, LINK_TRANSFER_CYCLES, &master.mem.io[REG_IF]);
+  ck_assert_uint_eq(master.mem.io[REG_SB], 0x34);
+  ck_assert_uint_eq(slave.mem.io[REG_SB], 0x12);
+
+  link_disconnect(&slave.link);
+  link_disconnect(&master.link);
+  link_cable_close_shared(second_p);
+  link_cable_close_shared(first_p);
+  link_cable_unlink_shared(name);
 }
 END_TEST
 
 Suite *gbemu_suite(void) {
   Suite *s;
-  TCase *tc_cart, *tc_cpu;
+  TCase *tc_cart, *tc_cpu, *tc_boot, *tc_sched, *tc_idle, *tc_sprite, *tc_dma;
+  TCase *tc_emu, *tc_state_hash, *tc_trace, *tc_link;
 
   s = suite_create("gbemu");
 
@@ -222,6 +1363,10 @@ Suite *gbemu_suite(void) {
   tcase_add_test(tc_cart, test_metadata_title_padding);
   tcase_add_test(tc_cart, test_get_rom_size);
   tcase_add_test(tc_cart, test_get_ram_size);
+  tcase_add_test(tc_cart, test_load_compressed_cart);
+  tcase_add_test(tc_cart, test_rom_file_format);
+  tcase_add_test(tc_cart, test_rom_zip_malformed);
+  tcase_add_test(tc_cart, test_rom_cache);
   suite_add_tcase(s, tc_cart);
 
   /* CPU tests */
@@ -235,6 +1380,71 @@ Suite *gbemu_suite(void) {
   tcase_add_test(tc_cpu, test_cpu_init);
   suite_add_tcase(s, tc_cpu);
 
+  /* Boot tests */
+  tc_boot = tcase_create("Boot");
+  tcase_add_test(tc_boot, test_boot_skip);
+  tcase_add_test(tc_boot, test_boot_skip_zero_checksum);
+  tcase_add_test(tc_boot, test_boot_skip_logo);
+  suite_add_tcase(s, tc_boot);
+
+  /* Scheduler tests */
+  tc_sched = tcase_create("Scheduler");
+  tcase_add_test(tc_sched, test_sched_next);
+  tcase_add_test(tc_sched, test_sched_fire_due_periodic);
+  suite_add_tcase(s, tc_sched);
+
+  /* Idle tests */
+  tc_idle = tcase_create("Idle");
+  tcase_add_test(tc_idle, test_cpu_halt_bug);
+  tcase_add_test(tc_idle, test_idle_skip_halt);
+  tcase_add_test(tc_idle, test_idle_skip_halt_limit);
+  tcase_add_test(tc_idle, test_idle_detect_poll);
+  tcase_add_test(tc_idle, test_idle_skip_poll);
+  suite_add_tcase(s, tc_idle);
+
+  /* Sprite tests */
+  tc_sprite = tcase_create("Sprite");
+  tcase_add_test(tc_sprite, test_sprite_cache_line_limit_and_priority);
+  tcase_add_test(tc_sprite, test_sprite_cache_invalidation);
+  suite_add_tcase(s, tc_sprite);
+
+  /* DMA tests */
+  tc_dma = tcase_create("DMA");
+  tcase_add_test(tc_dma, test_dma_transfer);
+  tcase_add_test(tc_dma, test_dma_source);
+  suite_add_tcase(s, tc_dma);
+
+  /* Instance tests */
+  tc_emu = tcase_create("Instance");
+  tcase_add_test(tc_emu, test_emu_create);
+  tcase_add_test(tc_emu, test_emu_create_missing_rom);
+  suite_add_tcase(s, tc_emu);
+
+  /* State hash tests */
+  tc_state_hash = tcase_create("State hash");
+  tcase_add_test(tc_state_hash, test_state_hash_bytes);
+  tcase_add_test(tc_state_hash, test_state_hash_cpu);
+  tcase_add_test(tc_state_hash, test_state_hash_log_round_trip);
+  tcase_add_test(tc_state_hash, test_state_hash_diff);
+  suite_add_tcase(s, tc_state_hash);
+
+  /* Trace tests */
+  tc_trace = tcase_create("Trace");
+  tcase_add_test(tc_trace, test_trace_round_trip);
+  tcase_add_test(tc_trace, test_trace_errors);
+  tcase_add_test(tc_trace, test_trace_format_doctor);
+  suite_add_tcase(s, tc_trace);
+
+  /* Link tests */
+  tc_link = tcase_create("Link");
+  tcase_add_test(tc_link, test_link_unconnected);
+  tcase_add_test(tc_link, test_link_exchange);
+  tcase_add_test(tc_link, test_link_threads);
+  tcase_add_test(tc_link, test_link_halted);
+  tcase_add_test(tc_link, test_link_dead_peer);
+  tcase_add_test(tc_link, test_link_shared);
+  suite_add_tcase(s, tc_link);
+
   return s;
 }
 
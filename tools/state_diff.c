@@ -0,0 +1,54 @@
+/**
+ * @file state_diff.c
+ * @brief Compare two state hash logs and report the first diverging frame
+ * @author Coaxial
+ * @date 2026-10-19
+ */
+
+#include "state_hash.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    printf("Usage: gbemu-statediff <expected_log> <actual_log>\n");
+    return 2;
+  }
+
+  FILE *expected_p = fopen(argv[1], "rb");
+  FILE *actual_p = fopen(argv[2], "rb");
+
+  if (expected_p == NULL || actual_p == NULL) {
+    printf("Error opening file: %s\n", expected_p ? argv[2] : argv[1]);
+    if (expected_p) {
+      fclose(expected_p);
+    }
+    if (actual_p) {
+      fclose(actual_p);
+    }
+    return 2;
+  }
+
+  state_hash_divergence_t divergence;
+  state_hash_diff_result_t result =
+      state_hash_diff(expected_p, actual_p, &divergence);
+
+  fclose(expected_p);
+  fclose(actual_p);
+
+  switch (result) {
+  case STATE_HASH_DIFF_IDENTICAL:
+    printf("Logs are identical\n");
+    return 0;
+  case STATE_HASH_DIFF_DIVERGED:
+    printf("First divergence at frame %u in %s (expected 0x%08X, got 0x%08X)\n",
+           divergence.frame, state_hash_component_name(divergence.component),
+           divergence.expected, divergence.actual);
+    return 1;
+  case STATE_HASH_DIFF_LENGTH:
+    printf("Logs agree until frame %u where %s log ends\n", divergence.frame,
+           divergence.expected ? "actual" : "expected");
+    return 1;
+  default:
+    printf("Not a state hash log, or written by another version\n");
+    return 2;
+  }
+}
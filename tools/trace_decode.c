@@ -0,0 +1,51 @@
+/**
+ * @file trace_decode.c
+ * @brief Convert a binary CPU trace into a gameboy-doctor log
+ * @author Coaxial
+ * @date 2026-10-19
+ */
+
+#include "trace.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: gbemu-tracedecode <trace_file> [log_file]\n");
+    return 2;
+  }
+
+  FILE *trace_file = fopen(argv[1], "rb");
+
+  if (trace_file == NULL) {
+    printf("Error opening file: %s\n", argv[1]);
+    return 2;
+  }
+
+  if (!trace_read_header(trace_file)) {
+    printf("Not a trace file, or written by another version\n");
+    fclose(trace_file);
+    return 2;
+  }
+
+  FILE *log_file = argc > 2 ? fopen(argv[2], "w") : stdout;
+
+  if (log_file == NULL) {
+    printf("Error opening file: %s\n", argv[2]);
+    fclose(trace_file);
+    return 2;
+  }
+
+  trace_record_t record;
+  char line[128];
+
+  while (trace_read_record(trace_file, &record)) {
+    trace_format_doctor(line, sizeof(line), &record);
+    fprintf(log_file, "%s\n", line);
+  }
+
+  fclose(trace_file);
+  if (log_file != stdout) {
+    fclose(log_file);
+  }
+
+  return 0;
+}